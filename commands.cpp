@@ -1,34 +1,163 @@
 // $Id: commands.cpp,v 1.18 2019-10-08 13:55:31-07 - - $
+#include <array>
+#include <cstdint>
 #include <filesystem>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 #include "commands.h"
 #include "debug.h"
-command_hash cmd_hash {
+#include "mapfile.h"
+#include "payloads.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "trace.h"
+// command_entry -
+//    One slot of the built-in command table.  Unused slots have an
+//    empty name, which never matches a command.
+
+struct command_entry {
+   string_view name;
+   command_fn fn;
+};
+
+constexpr command_entry builtins[] {
    {"cat"   , fn_cat   },
    {"cd"    , fn_cd    },
+   {"dedupstat", fn_dedupstat},
+   {"du"    , fn_du    },
    {"echo"  , fn_echo  },
    {"exit"  , fn_exit  },
+   {"export", fn_export},
+   {"grep"  , fn_grep  },
+   {"import", fn_import},
+   {"index" , fn_index },
    {"ls"    , fn_ls    },
+   {"load"  , fn_load  },
    {"lsr"   , fn_lsr   },
    {"make"  , fn_make  },
    {"mkdir" , fn_mkdir },
    {"prompt", fn_prompt},
    {"pwd"   , fn_pwd   },
    {"rm"    , fn_rm    },
-   {"rmr"    ,fn_rmr   },
+   {"rmr"   , fn_rmr   },
+   {"rollback" , fn_rollback },
+   {"save"  , fn_save  },
+   {"search", fn_search},
+   {"snapshot" , fn_snapshot },
+   {"snapshots", fn_snapshots},
+   {"stats" , fn_stats },
+   {"trace" , fn_trace },
 };
 
-command_fn find_command_fn (const string& cmd) {
-   // Note: value_type is pair<const key_type, mapped_type>
-   // So: iterator->first is key_type (string)
-   // So: iterator->second is mapped_type (command_fn)
+constexpr size_t command_slots {64};
+
+constexpr size_t name_hash (uint32_t seed, string_view name) {
+   uint32_t hash = 2166136261u ^ seed;
+   for (char chr: name) {
+      hash ^= static_cast<unsigned char> (chr);
+      hash *= 16777619u;
+   }
+   return (hash ^ (hash >> 16)) % command_slots;
+}
+
+// find_seed -
+//    Tries seeds until the hash sends every built-in command to a
+//    slot of its own.  Evaluated by the compiler, so a lookup is one
+//    hash and one compare, with no probing.
+
+constexpr uint32_t find_seed() {
+   for (uint32_t seed = 0;; ++seed) {
+      bool used[command_slots] {};
+      bool perfect = true;
+      for (const auto& entry: builtins) {
+         size_t slot = name_hash (seed, entry.name);
+         if (used[slot]) perfect = false;
+         used[slot] = true;
+      }
+      if (perfect) return seed;
+   }
+}
+
+constexpr uint32_t command_seed = find_seed();
+
+constexpr array<command_entry,command_slots> make_command_table() {
+   array<command_entry,command_slots> table {};
+   for (const auto& entry: builtins) {
+      table[name_hash (command_seed, entry.name)] = entry;
+   }
+   return table;
+}
+
+constexpr array<command_entry,command_slots> command_table =
+          make_command_table();
+
+constexpr command_fn find_builtin (string_view cmd) {
+   const command_entry& entry = command_table[name_hash (command_seed,
+                                                         cmd)];
+   return entry.name == cmd ? entry.fn : nullptr;
+}
+
+static_assert (find_builtin ("rmr") == fn_rmr);
+static_assert (find_builtin ("nosuchcommand") == nullptr);
+
+// registered_commands -
+//    Commands added by command_registrar, in the order they were
+//    added, and where each is.  Function-local statics, so that
+//    registrars in other translation units may run first.
+
+static vector<command_entry>& registered_commands() {
+   static vector<command_entry> commands;
+   return commands;
+}
+
+static unordered_map<string_view,size_t>& registered_index() {
+   static unordered_map<string_view,size_t> index;
+   return index;
+}
+
+command_registrar::command_registrar (string_view name,
+                                      command_fn fn) {
+   size_t next = registered_commands().size();
+   auto found = registered_index().emplace (name, next);
+   if (found.second) registered_commands().push_back ({name, fn});
+   else registered_commands()[found.first->second].fn = fn;
+}
+
+// find_command -
+//    The entry for a command and its number for stats:  a built-in's
+//    slot in the table, or for a registered command, the number after
+//    the last slot in the order it was added.
+
+static const command_entry& find_command (string_view cmd, size_t& id) {
    DEBUGF ('c', "[" << cmd << "]");
-   const auto result = cmd_hash.find (cmd);
+   id = name_hash (command_seed, cmd);
+   const command_entry& entry = command_table[id];
+   if (entry.name == cmd) return entry;
+   const auto result = registered_index().find (cmd);
+   if (result == registered_index().end()) {
+      throw command_error (string (cmd) + ": no such function");
+   }
+   id = command_slots + result->second;
+   return registered_commands()[result->second];
+}
+
+command_fn find_command_fn (string_view cmd) {
+   size_t id;
+   return find_command (cmd, id).fn;
+}
 
-   if (result == cmd_hash.end()) {
-      throw command_error (cmd + ": no such function");
+void execute (inode_state& state, wordspan words) {
+   try {
+      DEBUGF ('y', "words = " << words);
+      size_t id;
+      const command_entry& entry = find_command (words[0], id);
+      command_timer timer (id, entry.name);
+      TRACE ('y', "command", id, words.size());
+      entry.fn (state, words);
+   }catch (command_error& error) {
+      complain() << error.what() << endl;
    }
-   return result->second;
 }
 
 command_error::command_error (const string& what):
@@ -37,118 +166,336 @@ command_error::command_error (const string& what):
 
 int exit_status_message() {
    int status = exec::status();
+   output().flush();
    cout << exec::execname() << ": exit(" << status << ")" << endl;
    return status;
 }
 
-void fn_cat (inode_state& state, const wordvec& words){
+void fn_cat (inode_state& state, wordspan words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
-   auto i = words.cbegin() +1;
-   while (i != words.cend()){
-      state.readfile(*i);
+   auto i = words.begin() +1;
+   while (i != words.end()){
+      for(const string& path: state.glob(string(*i)))
+         state.readfile(path);
       ++i;
    }
-   
-   
 }
 
-void fn_cd (inode_state& state, const wordvec& words){
+void fn_cd (inode_state& state, wordspan words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    if(words.size() ==1 )
      state.cd("/");
    else
-     state.cd(words[1]);
+     state.cd(string(words[1]));
 }
 
-void fn_echo (inode_state& state, const wordvec& words){
+// fn_dedupstat -
+//    dedupstat prints how many files keep their text in the shared
+//    store and in how many blocks, and the bytes those would take
+//    unshared against the bytes they take.  Files short enough to
+//    keep their text inline, and files borrowed from a snapshot, are
+//    not counted.  A file removed is counted until it is freed, after
+//    a grace period.
+
+void fn_dedupstat ([[maybe_unused]] inode_state& state,
+                   wordspan words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
-   auto i = words.cbegin() +1;
-   while(i != words.cend()){
+   if(words.size() > 1)
+      throw command_error (string(words[0]) + ": usage: dedupstat");
+   payload_usage usage = payload_store::usage();
+   output() << "dedupstat: " << usage.files << " files, "
+            << usage.payloads << " payloads, " << usage.logical
+            << " logical bytes, " << usage.physical
+            << " physical bytes" << '\n';
+}
+
+void fn_du (inode_state& state, wordspan words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   if(words.size() ==1)
+     state.du(".");
+   else
+     state.du(string(words[1]));
+}
+
+void fn_echo ([[maybe_unused]] inode_state& state, wordspan words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   auto i = words.begin() +1;
+   while(i != words.end()){
      if(i->at(0) != '#')
-       cout<<*i << " ";
+       output() << *i << " ";
       ++i;
    }
-   cout << endl;
+   output() << '\n';
 }
 
 
-void fn_exit (inode_state& state, const wordvec& words){
+void fn_exit ([[maybe_unused]] inode_state& state, wordspan words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    if (words.size()>1)
-      exec::status(stoi(words[1]));
+      exec::status(stoi(string(words[1])));
    throw ysh_exit();
 }
 
-void fn_ls (inode_state& state, const wordvec& words){
+// fn_export -
+//    export [-r] path host_path copies a plain file of the tree out to
+//    the host, or with -r a directory and everything below it.
+
+void fn_export (inode_state& state, wordspan words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   bool recursive = words.size() > 1 && words[1] == "-r";
+   if(words.size() != (recursive ? 4u : 3u))
+      throw command_error (string(words[0])
+                           + ": usage: export [-r] path host_path");
+   try {
+      state.export_host(string(words[words.size() - 2]),
+                        string(words[words.size() - 1]), recursive);
+   }catch (file_error& error) {
+      throw command_error (string(words[0]) + ": " + error.what());
+   }catch (filesystem::filesystem_error& error) {
+      throw command_error (string(words[0]) + ": " + error.what());
+   }
+}
+
+// fn_grep -
+//    grep [-c | -l] pattern [path...] searches the text of the files
+//    at or below each path, the cwd if none is given.
+
+void fn_grep (inode_state& state, wordspan words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   size_t i = 1;
+   grep_mode mode = grep_mode::TEXT;
+   if(i < words.size() && (words[i] == "-c" || words[i] == "-l")){
+      mode = words[i] == "-c" ? grep_mode::COUNT : grep_mode::NAMES;
+      ++i;
+   }
+   if(i == words.size())
+      throw command_error (string(words[0]) + ": missing operand");
+   string pattern(words[i++]);
+   if(i == words.size())
+      state.grep(pattern, ".", mode);
+   for(; i < words.size(); ++i)
+      for(const string& path: state.glob(string(words[i])))
+         state.grep(pattern, path, mode);
+}
+
+// fn_import -
+//    import [-r] host_path path copies a host file into the tree, or
+//    with -r a host directory and everything below it.
+
+void fn_import (inode_state& state, wordspan words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   bool recursive = words.size() > 1 && words[1] == "-r";
+   if(words.size() != (recursive ? 4u : 3u))
+      throw command_error (string(words[0])
+                           + ": usage: import [-r] host_path path");
+   try {
+      state.import_host(string(words[words.size() - 2]),
+                        string(words[words.size() - 1]), recursive);
+   }catch (mapping_error& error) {
+      throw command_error (string(words[0]) + ": " + error.what());
+   }catch (filesystem::filesystem_error& error) {
+      throw command_error (string(words[0]) + ": " + error.what());
+   }
+}
+
+// fn_index -
+//    index on builds the word index and keeps it up to date, index off
+//    forgets it, and index alone says what it holds.
+
+void fn_index (inode_state& state, wordspan words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   if(words.size() > 2
+      || (words.size() == 2 && words[1] != "on" && words[1] != "off"))
+      throw command_error (string(words[0])
+                           + ": usage: index [on | off]");
+   if(words.size() == 1)
+      state.index_usage();
+   else
+      state.index(words[1] == "on");
+}
+
+void fn_ls (inode_state& state, wordspan words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    if(words.size() ==1)
      state.ls(".");
-   else
-     state.ls(words[1]); 
+   for(size_t i = 1; i < words.size(); ++i)
+      for(const string& path: state.glob(string(words[i])))
+         state.ls(path);
 }
 
-void fn_lsr (inode_state& state, const wordvec& words){
+void fn_load (inode_state& state, wordspan words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   if(words.size() == 1)
+      throw command_error (string(words[0]) + ": missing operand");
+   try {
+      state.load(string(words[1]));
+   }catch (mapping_error& error) {
+      throw command_error (string(words[0]) + ": " + error.what());
+   }catch (snapshot_error& error) {
+      throw command_error (string(words[0]) + ": " + error.what());
+   }
+}
+
+void fn_lsr (inode_state& state, wordspan words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    if(words.size() ==1)
      state.lsr("/");
    else
-     state.lsr(words[1]);
+     state.lsr(string(words[1]));
 }
 
-void fn_make (inode_state& state, const wordvec& words){
+void fn_make (inode_state& state, wordspan words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    if(words.size() == 1)
-      throw command_error (words[0] + ": invalid file name");
-   state.mkfile(words);
+      throw command_error (string(words[0]) + ": invalid file name");
+   state.mkfile(string(words[1]), words.subspan(2));
 }
 
-void fn_mkdir (inode_state& state, const wordvec& words){
+void fn_mkdir (inode_state& state, wordspan words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    if(words.size() == 1)
-      throw command_error (words[0] + ": invalid directory name");
-   state.mkdir(words[1]);
+      throw command_error (string(words[0])
+                           + ": invalid directory name");
+   state.mkdir(string(words[1]));
 }
 
-void fn_prompt (inode_state& state, const wordvec& words){
+void fn_prompt (inode_state& state, wordspan words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    string prompt;
-   auto i = words.cbegin() +1;
-      while(i != words.cend()){
-         prompt = prompt + *i + " ";
+   auto i = words.begin() +1;
+      while(i != words.end()){
+         prompt += *i;
+         prompt += " ";
          ++i;
       }
    state.changePrompt(prompt);
 }
 
-void fn_pwd (inode_state& state, const wordvec& words){
+void fn_pwd (inode_state& state, [[maybe_unused]] wordspan words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
-   string output = state.getDir();
-   cout << output << endl;
+   output() << state.getDir() << '\n';
 
    
 }
 
-void fn_rm (inode_state& state, const wordvec& words){
+void fn_rm (inode_state& state, wordspan words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
-   state.rm(words[1]);
+   if(words.size() == 1)
+      throw command_error (string(words[0]) + ": missing operand");
+   for(size_t i = 1; i < words.size(); ++i)
+      for(const string& path: state.glob(string(words[i])))
+         state.rm(path);
 }
 
-void fn_rmr (inode_state& state, const wordvec& words){
+void fn_rmr (inode_state& state, wordspan words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
-   state.rmr(words[1]);
+   if(words.size() == 1)
+      throw command_error (string(words[0]) + ": missing operand");
+   for(size_t i = 1; i < words.size(); ++i)
+      for(const string& path: state.glob(string(words[i])))
+         state.rmr(path);
 }
 
+void fn_rollback (inode_state& state, wordspan words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   if(words.size() == 1)
+      throw command_error (string(words[0]) + ": missing operand");
+   state.rollback(string(words[1]));
+}
 
+void fn_save (inode_state& state, wordspan words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   if(words.size() == 1)
+      throw command_error (string(words[0]) + ": missing operand");
+   try {
+      state.save(string(words[1]));
+   }catch (snapshot_error& error) {
+      throw command_error (string(words[0]) + ": " + error.what());
+   }catch (journal_error& error) {
+      throw command_error (string(words[0]) + ": journal: "
+                           + error.what());
+   }
+}
+
+// fn_search -
+//    search word prints each file holding the word, from the index.
+
+void fn_search (inode_state& state, wordspan words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   if(words.size() != 2)
+      throw command_error (string(words[0]) + ": usage: search word");
+   state.search(string(words[1]));
+}
+
+// fn_snapshot -
+//    snapshot name takes a snapshot, and snapshot -d name drops one.
+
+void fn_snapshot (inode_state& state, wordspan words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   if(words.size() == 1 || (words[1] == "-d" && words.size() == 2))
+      throw command_error (string(words[0]) + ": missing operand");
+   if(words[1] == "-d")
+      state.drop_snapshot(string(words[2]));
+   else
+      state.snapshot(string(words[1]));
+}
+
+void fn_snapshots (inode_state& state, [[maybe_unused]] wordspan words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   state.snapshots();
+}
+
+// fn_stats -
+//    stats prints how long each command has taken and what has been
+//    counted, and stats -j prints the same as JSON.
+
+void fn_stats ([[maybe_unused]] inode_state& state, wordspan words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   if(words.size() > 2 || (words.size() == 2 && words[1] != "-j"))
+      throw command_error (string(words[0]) + ": usage: stats [-j]");
+   if(words.size() == 2)
+      output() << stats::json();
+   else
+      stats::report(output());
+}
 
+// fn_trace -
+//    trace dump prints the events traced so far, and trace clear
+//    forgets them.
+
+void fn_trace ([[maybe_unused]] inode_state& state, wordspan words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   if(words.size() != 2 || (words[1] != "dump" && words[1] != "clear"))
+      throw command_error (string(words[0])
+                           + ": usage: trace dump | trace clear");
+   if(words[1] == "dump")
+      trace::dump(output());
+   else
+      trace::clear();
+}
@@ -3,17 +3,17 @@
 #ifndef __COMMANDS_H__
 #define __COMMANDS_H__
 
-#include <unordered_map>
 #include <fstream>
+#include <string_view>
 using namespace std;
 
 #include "file_sys.h"
 #include "util.h"
 
-// A couple of convenient usings to avoid verbosity.
+// A convenient using to avoid verbosity.  Commands receive views
+// of the words of the line, which must not outlive the call.
 
-using command_fn = void (*)(inode_state& state, const wordvec& words);
-using command_hash = unordered_map<string,command_fn>;
+using command_fn = void (*)(inode_state& state, wordspan words);
 
 // command_error -
 //    Extend runtime_error for throwing exceptions related to this 
@@ -26,20 +26,58 @@ class command_error: public runtime_error {
 
 // execution functions -
 
-void fn_cat    (inode_state& state, const wordvec& words);
-void fn_cd     (inode_state& state, const wordvec& words);
-void fn_echo   (inode_state& state, const wordvec& words);
-void fn_exit   (inode_state& state, const wordvec& words);
-void fn_ls     (inode_state& state, const wordvec& words);
-void fn_lsr    (inode_state& state, const wordvec& words);
-void fn_make   (inode_state& state, const wordvec& words);
-void fn_mkdir  (inode_state& state, const wordvec& words);
-void fn_prompt (inode_state& state, const wordvec& words);
-void fn_pwd    (inode_state& state, const wordvec& words);
-void fn_rm     (inode_state& state, const wordvec& words);
-void fn_rmr    (inode_state& state, const wordvec& words);
-
-command_fn find_command_fn (const string& command);
+void fn_cat    (inode_state& state, wordspan words);
+void fn_cd     (inode_state& state, wordspan words);
+void fn_dedupstat (inode_state& state, wordspan words);
+void fn_du     (inode_state& state, wordspan words);
+void fn_echo   (inode_state& state, wordspan words);
+void fn_exit   (inode_state& state, wordspan words);
+void fn_export (inode_state& state, wordspan words);
+void fn_grep   (inode_state& state, wordspan words);
+void fn_import (inode_state& state, wordspan words);
+void fn_index  (inode_state& state, wordspan words);
+void fn_ls     (inode_state& state, wordspan words);
+void fn_load   (inode_state& state, wordspan words);
+void fn_lsr    (inode_state& state, wordspan words);
+void fn_make   (inode_state& state, wordspan words);
+void fn_mkdir  (inode_state& state, wordspan words);
+void fn_prompt (inode_state& state, wordspan words);
+void fn_pwd    (inode_state& state, wordspan words);
+void fn_rm     (inode_state& state, wordspan words);
+void fn_rmr    (inode_state& state, wordspan words);
+void fn_rollback  (inode_state& state, wordspan words);
+void fn_save   (inode_state& state, wordspan words);
+void fn_search (inode_state& state, wordspan words);
+void fn_snapshot  (inode_state& state, wordspan words);
+void fn_snapshots (inode_state& state, wordspan words);
+void fn_stats  (inode_state& state, wordspan words);
+void fn_trace  (inode_state& state, wordspan words);
+
+// find_command_fn -
+//    Looks a command up, first in the table of built-in commands,
+//    which is perfectly hashed at compile time, then among those
+//    added by a command_registrar.  Throws a command_error if there
+//    is no such command.
+
+command_fn find_command_fn (string_view command);
+
+// execute -
+//    Look up the function for a command line already split into
+//    words, and complain about it or call it.  Every call is timed,
+//    for stats, whether it returns or throws.
+
+void execute (inode_state& state, wordspan words);
+
+// command_registrar -
+//    Adds a command to the shell from any translation unit, without
+//    touching the built-in table.  Define one at namespace scope:
+//       static command_registrar reg_foo {"foo", fn_foo};
+//    The name must be a string literal, since only a view is kept.
+
+class command_registrar {
+   public:
+      command_registrar (string_view name, command_fn fn);
+};
 
 // exit_status_message -
 //    Prints an exit message and returns the exit status, as recorded
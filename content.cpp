@@ -0,0 +1,298 @@
+// $Id: content.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+#include "content.h"
+#include "debug.h"
+#include "payloads.h"
+
+// The offset table follows the text, aligned for uint32_t.
+
+static size_t text_span (size_t length) {
+   return (length + sizeof (uint32_t) - 1)
+        / sizeof (uint32_t) * sizeof (uint32_t);
+}
+
+const uint32_t* file_content::offsets() const {
+   return reinterpret_cast<const uint32_t*> (heap + text_span (length));
+}
+
+void file_content::release() {
+   if (heap != nullptr and not borrowed) payload_store::drop (heap);
+   heap = nullptr;
+   borrowed = false;
+   length = 0;
+   words = 0;
+}
+
+void file_content::assign (wordspan range) {
+   release();
+   size_t count = range.size();
+   size_t total = 0;
+   for (const auto& word: range) total += word.size();
+   if (count > 0) total += count - 1;
+
+   length = total;
+   words = count;
+   payload_key key;
+   if (total > inline_capacity) {
+      // A file with the same text as one already stored shares it,
+      // without a block being made at all.
+      payload_hasher hasher;
+      hasher.update_joined (range, ' ');
+      key = hasher.finish();
+      heap = payload_store::find (key, total,
+             [range] (string_view text) {
+                size_t pos = 0;
+                for (const auto& word: range) {
+                   if (pos > 0 and text[pos++] != ' ') return false;
+                   if (text.compare (pos, word.size(), word) != 0) {
+                      return false;
+                   }
+                   pos += word.size();
+                }
+                return true;
+             });
+      if (heap != nullptr) return;
+   }
+
+   char* text = inline_text;
+   uint32_t* starts = nullptr;
+   if (total > inline_capacity) {
+      size_t span = text_span (total);
+      heap = payload_store::make (span + count * sizeof (uint32_t));
+      text = heap;
+      starts = reinterpret_cast<uint32_t*> (heap + span);
+   }
+   size_t pos = 0;
+   for (const auto& word: range) {
+      if (pos > 0) text[pos++] = ' ';
+      if (starts != nullptr) *starts++ = pos;
+      memcpy (text + pos, word.data(), word.size());
+      pos += word.size();
+   }
+   if (heap != nullptr) heap = payload_store::share (heap, key, total);
+   DEBUGF ('f', words << " words, " << length << " bytes, "
+          << (heap == nullptr ? "inline" : "heap"));
+}
+
+// is_space -
+//    Host text is split at any white space, not only at the blanks
+//    between the words of a command line.
+
+static inline bool is_space (char chr) {
+   return chr == ' ' or (chr >= '\t' and chr <= '\r');
+}
+
+#ifdef __SSE2__
+// space_bytes -
+//    Which of the 16 bytes in chunk are white space, as a byte of all
+//    ones each.  Tab through carriage return are the bytes 9 through
+//    13, which less 9 are the only bytes from 0 to 4 as signed chars.
+
+static inline __m128i space_bytes (__m128i chunk) {
+   __m128i less = _mm_sub_epi8 (chunk, _mm_set1_epi8 ('\t'));
+   __m128i controls = _mm_and_si128 (
+                      _mm_cmpgt_epi8 (less, _mm_set1_epi8 (-1)),
+                      _mm_cmplt_epi8 (less, _mm_set1_epi8 (5)));
+   return _mm_or_si128 (controls,
+          _mm_cmpeq_epi8 (chunk, _mm_set1_epi8 (' ')));
+}
+#endif
+
+// count_words -
+//    Adds the words that start in a range, and the bytes of every
+//    word in it, to the counts.  in_word says whether the byte
+//    before the range was part of a word, and is left saying whether
+//    the last byte of the range is.  Blocks are counted in the byte
+//    lanes of two vectors, which are summed every 255 blocks before
+//    any lane can overflow, since without popcnt counting the bits
+//    of each block costs more than finding them.
+
+static void count_words (const char* itor, const char* end,
+                         bool& in_word, size_t& count,
+                         size_t& bytes) {
+#ifdef __SSE2__
+   __m128i zero = _mm_setzero_si128();
+   __m128i before = _mm_cvtsi32_si128 (in_word ? 0xFF : 0);
+   while (end - itor >= 16) {
+      __m128i lane_starts = zero;
+      __m128i lane_letters = zero;
+      for (int block = 0; block < 255 and end - itor >= 16;
+           ++block, itor += 16) {
+         __m128i letters = _mm_cmpeq_epi8 (space_bytes (
+                 _mm_loadu_si128 (
+                 reinterpret_cast<const __m128i*> (itor))), zero);
+         __m128i after = _mm_or_si128 (_mm_slli_si128 (letters, 1),
+                                       before);
+         // Each lane of all ones is -1, so subtracting it counts one.
+         lane_starts = _mm_sub_epi8 (lane_starts,
+                       _mm_andnot_si128 (after, letters));
+         lane_letters = _mm_sub_epi8 (lane_letters, letters);
+         before = _mm_srli_si128 (letters, 15);
+      }
+      __m128i sums = _mm_sad_epu8 (lane_starts, zero);
+      count += _mm_cvtsi128_si32 (sums)
+             + _mm_extract_epi16 (sums, 4);
+      sums = _mm_sad_epu8 (lane_letters, zero);
+      bytes += _mm_cvtsi128_si32 (sums)
+             + _mm_extract_epi16 (sums, 4);
+   }
+   in_word = _mm_cvtsi128_si32 (before) != 0;
+#endif
+   for (; itor != end; ++itor) {
+      bool letter = not is_space (*itor);
+      count += letter and not in_word;
+      bytes += letter;
+      in_word = letter;
+   }
+}
+
+// copy_byte, copy_words -
+//    Copy the words in a range into the text at pos, with one blank
+//    between each two, and note where each starts if starts is not
+//    null.  in_word is as for count_words.  A blank is written after
+//    each word as its white space is met, except at limit, the end
+//    of the text, so white space after the last word is dropped.
+//    A block of 16 bytes in which every white space byte follows a
+//    letter is written whole, its white space made blanks, so text
+//    of words and single separators goes a block at a time.
+
+static inline void copy_byte (char chr, char* into, uint32_t*& starts,
+                              size_t& pos, size_t limit,
+                              bool& in_word) {
+   bool letter = not is_space (chr);
+   if (letter) {
+      if (not in_word and starts != nullptr) *starts++ = pos;
+      into[pos++] = chr;
+   }else if (in_word and pos < limit) {
+      into[pos++] = ' ';
+   }
+   in_word = letter;
+}
+
+static void copy_words (const char* itor, const char* end, char* into,
+                        uint32_t*& starts, size_t& pos, size_t limit,
+                        bool& in_word) {
+#ifdef __SSE2__
+   for (; end - itor >= 16; itor += 16) {
+      __m128i chunk = _mm_loadu_si128 (
+                      reinterpret_cast<const __m128i*> (itor));
+      __m128i spaces = space_bytes (chunk);
+      unsigned mask = _mm_movemask_epi8 (spaces);
+      unsigned letters = ~mask & 0xFFFF;
+      unsigned after_letter = letters << 1 | in_word;
+      if (pos + 16 > limit or (mask & ~after_letter) != 0) {
+         for (int byte = 0; byte < 16; ++byte) {
+            copy_byte (itor[byte], into, starts, pos, limit, in_word);
+         }
+         continue;
+      }
+      __m128i blanks = _mm_and_si128 (spaces, _mm_set1_epi8 (' '));
+      _mm_storeu_si128 (reinterpret_cast<__m128i*> (into + pos),
+                        _mm_or_si128 (blanks,
+                        _mm_andnot_si128 (spaces, chunk)));
+      if (starts != nullptr) {
+         for (unsigned begun = letters & ~after_letter; begun != 0;
+              begun &= begun - 1) {
+            *starts++ = pos + __builtin_ctz (begun);
+         }
+      }
+      pos += 16;
+      in_word = letters >> 15;
+   }
+#endif
+   for (; itor != end; ++itor) {
+      copy_byte (*itor, into, starts, pos, limit, in_word);
+   }
+}
+
+void file_content::assign_text (string_view text,
+                          const function<void (size_t, size_t)>& done) {
+   release();
+   const char* begin = text.data();
+   size_t count = 0;
+   size_t total = 0;
+   bool in_word = false;
+   for (size_t from = 0; from < text.size(); from += text_chunk) {
+      size_t to = min (text.size(), from + text_chunk);
+      count_words (begin + from, begin + to, in_word, count, total);
+      done (from, to);
+   }
+   if (count > 0) total += count - 1;
+
+   char* into = inline_text;
+   uint32_t* starts = nullptr;
+   if (total > inline_capacity) {
+      size_t span = text_span (total);
+      heap = payload_store::make (span + count * sizeof (uint32_t));
+      into = heap;
+      starts = reinterpret_cast<uint32_t*> (heap + span);
+   }
+   size_t pos = 0;
+   in_word = false;
+   for (size_t from = 0; from < text.size(); from += text_chunk) {
+      size_t to = min (text.size(), from + text_chunk);
+      copy_words (begin + from, begin + to, into, starts, pos, total,
+                  in_word);
+      done (from, to);
+   }
+   length = total;
+   words = count;
+   // Only here is the text whole, so it is hashed, and shared if it
+   // can be, after its block is made.
+   if (heap != nullptr) {
+      heap = payload_store::share (heap,
+             payload_hasher::hash ({heap, length}), total);
+   }
+   DEBUGF ('f', words << " words, " << length << " bytes, "
+          << (heap == nullptr ? "inline" : "heap"));
+}
+
+string_view file_content::word (size_t index) const {
+   if (heap != nullptr) {
+      const uint32_t* starts = offsets();
+      size_t end = index + 1 < words ? starts[index + 1] - 1 : length;
+      return text().substr (starts[index], end - starts[index]);
+   }
+   // Inline files are short enough to scan for the word.
+   string_view all = text();
+   size_t start = 0;
+   for (; index > 0; --index) start = all.find (' ', start) + 1;
+   return all.substr (start, all.find (' ', start) - start);
+}
+
+size_t file_content::image_size (size_t size, size_t count) {
+   return text_span (size) + count * sizeof (uint32_t);
+}
+
+void file_content::append_image (string& image) const {
+   string_view all = text();
+   image.append (all);
+   image.append (text_span (length) - length, '\0');
+   uint32_t start = 0;
+   for (size_t index = 0; index < words; ++index) {
+      image.append (reinterpret_cast<const char*> (&start),
+                    sizeof start);
+      start = all.find (' ', start) + 1;
+   }
+}
+
+void file_content::borrow (const char* image, size_t size,
+                           size_t count) {
+   release();
+   heap = const_cast<char*> (image);
+   borrowed = true;
+   length = size;
+   words = count;
+}
+
@@ -0,0 +1,81 @@
+// $Id: content.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// file_content -
+//    The words of a plain file, stored as one contiguous run of text
+//    with the words separated by single spaces, exactly as cat
+//    prints them.  Files of up to inline_capacity bytes keep their
+//    text inside the object itself, and so inside the inode's slab
+//    slot.  Larger files keep the text in one heap block, followed by
+//    a table of word offsets, which the payload store shares among
+//    all files with the same text.  A file loaded from a snapshot
+//    borrows its text and offsets from the mapped image instead, in
+//    the same layout, until it is next written.
+// assign -
+//    Replaces the contents with the given words.  The words are hashed
+//    first, and a block with the same text is shared if there is one,
+//    so that a copy of a file costs no block of its own.
+// assign_text -
+//    Replaces the contents with the words of a host file's text, split
+//    at any white space, without making a list of them first.  One
+//    pass counts the words and their bytes, and a second copies them
+//    straight into a block of exactly that size.  Each pass reads the
+//    text a chunk at a time, and calls done with the range of each
+//    chunk it is finished with, so that the caller may let it go.
+//    The text is hashed, and shared if it can be, once its block is
+//    filled.  The text must be shorter than 4 GB.
+// append_image -
+//    Appends the text and word offsets, as a heap block lays them
+//    out, for writing to a snapshot.  image_size gives the length.
+// borrow -
+//    Uses an image written by append_image in place, without copying.
+//    The image must outlive the contents or the next assign.
+// text -
+//    Returns the whole text.  Its length is the size of the file.
+// word -
+//    Returns one word, by position.
+
+#ifndef __CONTENT_H__
+#define __CONTENT_H__
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+using namespace std;
+
+#include "util.h"
+
+class file_content {
+   private:
+      // One byte short of 40 so the flag costs no space.
+      static constexpr size_t inline_capacity {39};
+      static constexpr size_t text_chunk {1 << 24};
+      uint32_t length {0};
+      uint32_t words {0};
+      char* heap {nullptr};
+      bool borrowed {false};
+      char inline_text[inline_capacity];
+      const char* data() const {
+         return heap == nullptr ? inline_text : heap;
+      }
+      const uint32_t* offsets() const;
+      void release();
+   public:
+      file_content() = default;
+      file_content (const file_content&) = delete;
+      file_content& operator= (const file_content&) = delete;
+      ~file_content() { release(); }
+      void assign (wordspan range);
+      void assign_text (string_view text,
+                        const function<void (size_t, size_t)>& done);
+      void append_image (string& image) const;
+      void borrow (const char* image, size_t size, size_t count);
+      static size_t image_size (size_t size, size_t count);
+      string_view text() const { return {data(), length}; }
+      size_t size() const { return length; }
+      size_t word_count() const { return words; }
+      string_view word (size_t index) const;
+};
+
+#endif
+
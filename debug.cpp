@@ -28,6 +28,7 @@ bool debugflags::getflag (char flag) {
 
 void debugflags::where (char flag, const char* file, int line,
                         const char* pretty_function) {
+   output().flush();
    cout << "DEBUG(" << flag << ") "
         << file << "[" << line << "] " << endl
         << "... " << pretty_function << endl;
@@ -0,0 +1,98 @@
+// $Id: dedupbench.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// dedupbench -
+//    Measures what sharing file text saves.  A tree of dirs
+//    directories with files files each is built, every file holding
+//    words words, about 6 bytes each; its text is one of distinct
+//    texts, as copied configs and generated stubs would be.  With
+//    distinct as large as the number of files, no two are alike.
+//    Prints CSV:  files, distinct texts, mean microseconds per make,
+//    logical and physical megabytes from dedupstat, and the growth
+//    of the resident set in megabytes while the tree was built.
+//    Arguments:  dirs (64), files (256), words (512), distinct (16).
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "commands.h"
+#include "file_sys.h"
+#include "util.h"
+
+using bench_clock = chrono::steady_clock;
+
+// resident_megabytes -
+//    The resident set now, from /proc.
+
+double resident_megabytes() {
+   ifstream status ("/proc/self/status");
+   for (string line; getline (status, line);) {
+      if (line.compare (0, 6, "VmRSS:") == 0) {
+         return stod (line.substr (6)) / 1024;
+      }
+   }
+   return 0;
+}
+
+int main (int argc, char** argv) {
+   int dirs = argc > 1 ? stoi (argv[1]) : 64;
+   int files = argc > 2 ? stoi (argv[2]) : 256;
+   int words = argc > 3 ? stoi (argv[3]) : 512;
+   int distinct = argc > 4 ? stoi (argv[4]) : 16;
+   static const char* vocabulary[] {
+      "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+      "error", "warning", "status", "value", "table", "entry",
+      "request", "response",
+   };
+   mt19937 random (1);
+   vector<wordvec> texts (distinct);
+   for (auto& text: texts) {
+      for (int word = 0; word < words; ++word) {
+         text.push_back (vocabulary[random() % 16]);
+      }
+   }
+
+   inode_state state;
+   double before = resident_megabytes();
+   auto start = bench_clock::now();
+   for (int dir = 0; dir < dirs; ++dir) {
+      string name = "d" + to_string (dir);
+      state.mkdir (name);
+      state.cd (name);
+      for (int file = 0; file < files; ++file) {
+         const wordvec& text = texts[random() % distinct];
+         viewvec views (text.begin(), text.end());
+         state.mkfile ("f" + to_string (file), views);
+      }
+      state.cd ("/");
+   }
+   chrono::duration<double,micro> make_time =
+         bench_clock::now() - start;
+   double after = resident_megabytes();
+
+   output_sink out;
+   ostringstream errors;
+   {
+      output_scope scope (out, errors);
+      execute (state, viewvec {"dedupstat"});
+   }
+   // dedupstat: N files, N payloads, N logical bytes, N physical bytes
+   wordvec fields = split (string (out.text()), " ");
+   double logical = stod (fields[5]) / (1 << 20);
+   double physical = stod (fields[8]) / (1 << 20);
+
+   cout << "files,distinct,make_us,logical_mb,physical_mb,rss_mb"
+        << endl;
+   cout << dirs * files << "," << distinct << ","
+        << make_time.count() / (dirs * files) << "," << logical << ","
+        << physical << "," << after - before << endl;
+   return EXIT_SUCCESS;
+}
+
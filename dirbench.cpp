@@ -0,0 +1,135 @@
+// $Id: dirbench.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// dirbench -
+//    Compares dirent_table against the std::map that directories
+//    used to hold, for lookup, insertion, and ordered iteration at a
+//    range of directory sizes, and times dirent_version, which a
+//    directory publishes instead of changing a table in place.
+//    Prints one CSV line per measurement, with times in nanoseconds
+//    per entry.  Operations on the tables include translating the
+//    name to its interned id, as the directory code does.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "dirents.h"
+
+using bench_clock = chrono::steady_clock;
+
+// Names look like the ones in real trees:  a short common stem and
+// a numeric suffix, shuffled so that insertion order is random.
+
+vector<string> make_names (size_t count, mt19937& rng) {
+   static const char* stems[] {"src", "index", "data", "lib", "test"};
+   vector<string> names;
+   names.reserve (count);
+   for (size_t num = 0; num < count; ++num) {
+      names.push_back (string (stems[num % 5]) + to_string (num));
+   }
+   shuffle (names.begin(), names.end(), rng);
+   return names;
+}
+
+size_t key_size (const string& key) { return key.size(); }
+size_t key_size (name_id key) { return name_table::name (key).size(); }
+
+// version_chain -
+//    A directory's entries as it keeps them:  each insert makes the
+//    next version from the current one, which is then dropped.  A
+//    version drops a change to a null inode that removes nothing, so
+//    entries point at a stand-in that is never followed.
+
+struct version_chain {
+   unique_ptr<dirent_version> now {
+      make_unique<dirent_version> (dirent_table())
+   };
+   dirent_version::const_iterator begin() const {
+      return now->begin();
+   }
+   dirent_version::const_iterator end() const { return now->end(); }
+};
+
+static char stand_in;
+inode* const some_inode = reinterpret_cast<inode*> (&stand_in);
+
+template <typename fn_t>
+double time_ns (size_t ops, fn_t fn) {
+   auto start = bench_clock::now();
+   fn();
+   chrono::duration<double,nano> spent = bench_clock::now() - start;
+   return spent.count() / ops;
+}
+
+template <typename table_t, typename insert_t, typename find_t>
+void run (const char* label, size_t size, size_t rounds,
+          const vector<string>& names, insert_t insert, find_t find) {
+   size_t sink = 0;
+   vector<table_t> tables (rounds);
+   double insert_ns = time_ns (size * rounds, [&] {
+      for (auto& table: tables) {
+         for (const auto& name: names) insert (table, name);
+      }
+   });
+   double find_ns = time_ns (size * rounds, [&] {
+      for (const auto& table: tables) {
+         for (const auto& name: names) sink += find (table, name);
+      }
+   });
+   auto iterate = [&] {
+      for (const auto& table: tables) {
+         for (const auto& entry: table) sink += key_size (entry.first);
+      }
+   };
+   // The first walk pays for any lazy sorting, later ones do not.
+   double first_walk_ns = time_ns (size * rounds, iterate);
+   double walk_ns = time_ns (size * rounds, iterate);
+   cout << label << "," << size << "," << insert_ns << ","
+        << find_ns << "," << first_walk_ns << "," << walk_ns << endl;
+   if (sink == 0) cerr << "dirbench: nothing was found" << endl;
+}
+
+int main (int argc, char** argv) {
+   size_t budget = argc > 1 ? stoul (argv[1]) : 2000000;
+   mt19937 rng (111);
+   cout << "container,size,insert_ns,find_ns,first_walk_ns,walk_ns"
+        << endl;
+   for (size_t size: {4, 8, 16, 64, 1024, 100000, 1000000}) {
+      size_t rounds = max<size_t> (1, budget / size);
+      vector<string> names = make_names (size, rng);
+      run<map<string,inode*>> ("map", size, rounds, names,
+         [] (map<string,inode*>& table, const string& name) {
+            table[name] = nullptr;
+         },
+         [] (const map<string,inode*>& table, const string& name) {
+            return table.count (name);
+         });
+      run<dirent_table> ("dirent_table", size, rounds, names,
+         [] (dirent_table& table, const string& name) {
+            table.assign (name_table::intern (name), nullptr);
+         },
+         [] (const dirent_table& table, const string& name) {
+            return static_cast<size_t> (
+                   table.contains (name_table::find (name)));
+         });
+      run<version_chain> ("dirent_version", size, rounds, names,
+         [] (version_chain& chain, const string& name) {
+            chain.now = chain.now->assign (name_table::intern (name),
+                                           some_inode);
+         },
+         [] (const version_chain& chain, const string& name) {
+            return static_cast<size_t> (
+                   chain.now->contains (name_table::find (name)));
+         });
+   }
+   return EXIT_SUCCESS;
+}
+
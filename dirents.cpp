@@ -0,0 +1,414 @@
+// $Id: dirents.cpp,v 1.3 2026-10-17 12:00:00-07 - - $
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+using namespace std;
+
+#include "debug.h"
+#include "dirents.h"
+
+// small_find -
+//    Scans the small vector for a name id.  With at most small_limit
+//    entries, comparing integers beats a binary search by text.
+
+size_t dirent_table::small_find (name_id name) const {
+   size_t index = 0;
+   while (index < entries.size() and entries[index].first != name) {
+      ++index;
+   }
+   return index;
+}
+
+// slot_of -
+//    Linear probe for name, returning the slot that holds it or the
+//    empty slot that ends its probe sequence.
+
+size_t dirent_table::slot_of (name_id name) const {
+   size_t mask = slots.size() - 1;
+   for (size_t pos = hash (name) & mask;; pos = (pos + 1) & mask) {
+      uint32_t slot = slots[pos];
+      if (slot == empty_slot or entries[slot - 1].first == name) {
+         return pos;
+      }
+   }
+}
+
+void dirent_table::place (uint32_t index) const {
+   size_t mask = slots.size() - 1;
+   size_t pos = hash (entries[index].first) & mask;
+   while (slots[pos] != empty_slot) pos = (pos + 1) & mask;
+   slots[pos] = index + 1;
+}
+
+void dirent_table::rehash (size_t capacity) const {
+   slots.assign (capacity, empty_slot);
+   for (uint32_t index = 0; index < entries.size(); ++index) {
+      place (index);
+   }
+   DEBUGF ('d', "rehash " << entries.size() << " into " << capacity);
+}
+
+void dirent_table::to_hashed() {
+   rehash (small_limit * 4);
+   sorted = entries.size();
+}
+
+void dirent_table::to_small() {
+   sort (entries.begin(), entries.end(),
+         [] (const entry& left, const entry& right) {
+            return name_table::less (left.first, right.first);
+         });
+   vector<uint32_t>().swap (slots);
+   sorted = 0;
+}
+
+inode* dirent_table::find (name_id name) const {
+   if (not hashed()) {
+      size_t index = small_find (name);
+      return index < entries.size() ? entries[index].second : nullptr;
+   }
+   uint32_t slot = slots[slot_of (name)];
+   return slot == empty_slot ? nullptr : entries[slot - 1].second;
+}
+
+bool dirent_table::contains (name_id name) const {
+   if (not hashed()) return small_find (name) < entries.size();
+   return slots[slot_of (name)] != empty_slot;
+}
+
+void dirent_table::assign (name_id name, inode* node) {
+   if (not hashed()) {
+      size_t index = small_find (name);
+      if (index < entries.size()) {
+         entries[index].second = node;
+         return;
+      }
+      auto itor = upper_bound (entries.begin(), entries.end(), name,
+                     [] (name_id key, const entry& ent) {
+                        return name_table::less (key, ent.first);
+                     });
+      entries.emplace (itor, name, node);
+      if (entries.size() > small_limit) to_hashed();
+      return;
+   }
+   size_t pos = slot_of (name);
+   if (slots[pos] != empty_slot) {
+      entries[slots[pos] - 1].second = node;
+      return;
+   }
+   uint32_t index = entries.size();
+   entries.emplace_back (name, node);
+   if (entries.size() * 4 > slots.size() * 3) {
+      rehash (slots.size() * 2);
+   }else {
+      slots[pos] = index + 1;
+   }
+}
+
+bool dirent_table::erase (name_id name) {
+   if (not hashed()) {
+      size_t index = small_find (name);
+      if (index == entries.size()) return false;
+      entries.erase (entries.begin() + index);
+      return true;
+   }
+   size_t mask = slots.size() - 1;
+   size_t hole = slot_of (name);
+   if (slots[hole] == empty_slot) return false;
+   uint32_t index = slots[hole] - 1;
+
+   // Backward shift deletion keeps every probe sequence unbroken
+   // without leaving tombstones behind.
+   for (size_t next = (hole + 1) & mask; slots[next] != empty_slot;
+        next = (next + 1) & mask) {
+      size_t home = hash (entries[slots[next] - 1].first) & mask;
+      if (((next - home) & mask) >= ((next - hole) & mask)) {
+         slots[hole] = slots[next];
+         hole = next;
+      }
+   }
+   slots[hole] = empty_slot;
+
+   // Fill the gap in the dense storage with the last entry.
+   uint32_t last = entries.size() - 1;
+   if (index != last) {
+      entries[index] = move (entries[last]);
+      size_t pos = hash (entries[index].first) & mask;
+      while (slots[pos] != last + 1) pos = (pos + 1) & mask;
+      slots[pos] = index + 1;
+   }
+   entries.pop_back();
+   sorted = min (sorted, static_cast<size_t> (index));
+   if (entries.size() <= small_limit / 2) to_small();
+   return true;
+}
+
+dirent_table dirent_table::from_sorted (vector<entry> ordered) {
+   dirent_table table;
+   table.entries = move (ordered);
+   if (table.entries.size() > small_limit) {
+      size_t capacity = small_limit * 4;
+      while (table.entries.size() * 4 > capacity * 3) capacity *= 2;
+      table.rehash (capacity);
+      table.sorted = table.entries.size();
+   }
+   return table;
+}
+
+void dirent_table::clear() {
+   entries.clear();
+   to_small();
+}
+
+// sort_view -
+//    Entries appended since the last ordered walk are sorted on
+//    their own and merged with the sorted prefix, then the index is
+//    rebuilt.  A walk after a few insertions thus costs O(n) rather
+//    than a full sort, and the walk itself reads the vector in order.
+
+void dirent_table::sort_view() const {
+   if (sorted == entries.size()) return;
+   auto less = [] (const entry& left, const entry& right) {
+      return name_table::less (left.first, right.first);
+   };
+   auto middle = entries.begin() + sorted;
+   sort (middle, entries.end(), less);
+   inplace_merge (entries.begin(), middle, entries.end(), less);
+   rehash (slots.size());
+   sorted = entries.size();
+}
+
+dirent_table::const_iterator dirent_table::begin() const {
+   if (hashed()) sort_view();
+   return const_iterator (this, 0);
+}
+
+dirent_table::const_iterator dirent_table::end() const {
+   if (hashed()) sort_view();
+   return const_iterator (this, entries.size());
+}
+
+dirent_version::dirent_version (dirent_table table) {
+   auto sealed = make_shared<dirent_table> (move (table));
+   sealed->seal();
+   count = sealed->size();
+   base = move (sealed);
+}
+
+static bool entry_less (const dirent_table::entry& ent, name_id name) {
+   return name_table::less (ent.first, name);
+}
+
+// chunk_of -
+//    The chunk that holds the change for name if there is one, or
+//    where it would go:  the first whose last change is not before
+//    name, or the last if name is after them all.
+
+size_t dirent_version::chunk_of (name_id name) const {
+   if (changes.size() < 2) return 0;
+   size_t index = partition_point (changes.begin(), changes.end(),
+                  [name] (const shared_ptr<const chunk>& part) {
+                     return name_table::less (part->back().first,
+                                              name);
+                  }) - changes.begin();
+   return index == changes.size() and index > 0 ? index - 1 : index;
+}
+
+// find_change -
+//    Picking the chunk compares text, but within it ids are compared,
+//    which for at most twice chunk_size entries beats a binary search
+//    by text.
+
+const dirent_version::entry*
+dirent_version::find_change (name_id name) const {
+   // Lookups of names never interned pass no_name, which has no text.
+   if (changes.empty() or name == name_table::no_name) return nullptr;
+   const chunk& part = *changes[chunk_of (name)];
+   const entry* itor = part.data();
+   const entry* end = itor + part.size();
+   while (itor != end and itor->first != name) ++itor;
+   return itor != end ? itor : nullptr;
+}
+
+inode* dirent_version::find (name_id name) const {
+   const entry* change = find_change (name);
+   return change != nullptr ? change->second : base->find (name);
+}
+
+// set_change -
+//    Records node as the change for name in a version not yet
+//    published, copying only the chunk it goes in, and returns the
+//    inode name had before.  A null node removes the base entry, or,
+//    if the base has none, just forgets the change.  A chunk that
+//    outgrows twice chunk_size is split.
+
+inode* dirent_version::set_change (name_id name, inode* node) {
+   bool keep = node != nullptr or base->contains (name);
+   if (changes.empty()) {
+      if (keep) {
+         changes.push_back (make_shared<const chunk> (
+                            chunk {{name, node}}));
+         ++change_count;
+      }
+      return base->find (name);
+   }
+   size_t index = chunk_of (name);
+   const chunk& old = *changes[index];
+   auto part = make_shared<chunk>();
+   part->reserve (old.size() + 1);
+   part->assign (old.begin(), old.end());
+   auto itor = std::lower_bound (part->begin(), part->end(), name,
+                                 entry_less);
+   bool found = itor != part->end() and itor->first == name;
+   inode* before = found ? itor->second : base->find (name);
+   if (found and keep) {
+      itor->second = node;
+   }else if (found) {
+      part->erase (itor);
+      --change_count;
+   }else if (keep) {
+      part->emplace (itor, name, node);
+      ++change_count;
+   }
+   if (part->empty()) {
+      changes.erase (changes.begin() + index);
+      return before;
+   }
+   if (part->size() > 2 * chunk_size) {
+      auto upper = make_shared<const chunk> (
+                   part->begin() + chunk_size, part->end());
+      part->resize (chunk_size);
+      changes.insert (changes.begin() + index + 1, move (upper));
+   }
+   changes[index] = move (part);
+   return before;
+}
+
+unique_ptr<dirent_version> dirent_version::assign (name_id name,
+                                                   inode* node) const {
+   auto next = make_unique<dirent_version> (*this);
+   if (next->set_change (name, node) == nullptr) ++next->count;
+   next->fold_if_due();
+   return next;
+}
+
+unique_ptr<dirent_version> dirent_version::erase (name_id name) const {
+   auto next = make_unique<dirent_version> (*this);
+   if (not contains (name)) return next;
+   next->set_change (name, nullptr);
+   --next->count;
+   next->fold_if_due();
+   return next;
+}
+
+// fold_if_due -
+//    Folds the changes into a new table once they number more than
+//    about sqrt (chunk_size * n), or once erasures have left their
+//    chunks so sparse that there are too many to copy.  Walking the
+//    version yields the new table's entries in order.
+
+void dirent_version::fold_if_due() {
+   size_t limit = chunk_size;
+   while (limit * limit < chunk_size * base->size()) limit *= 2;
+   if (change_count <= limit
+       and changes.size() <= 2 * limit / chunk_size) return;
+   vector<entry> merged;
+   merged.reserve (count);
+   for (const entry& ent: *this) merged.push_back (ent);
+   base = make_shared<const dirent_table> (
+          dirent_table::from_sorted (move (merged)));
+   vector<shared_ptr<const chunk>>().swap (changes);
+   change_count = 0;
+   DEBUGF ('d', "folded into " << base->size());
+}
+
+dirent_version::const_iterator::const_iterator (
+                                const dirent_version* ver):
+                version (ver) {
+   settle();
+}
+
+dirent_version::const_iterator::const_iterator (
+                                const dirent_version* ver,
+                                string_view from):
+                version (ver) {
+   auto before = [from] (name_id name) {
+      return name_table::name (name) < from;
+   };
+   auto entry_before = [&before] (const entry& ent) {
+      return before (ent.first);
+   };
+   const vector<entry>& base = version->base->entries;
+   const auto& changes = version->changes;
+   base_at = partition_point (base.begin(), base.end(), entry_before)
+             - base.begin();
+   chunk_at = partition_point (changes.begin(), changes.end(),
+              [&before] (const shared_ptr<const chunk>& part) {
+                 return before (part->back().first);
+              }) - changes.begin();
+   if (chunk_at < changes.size()) {
+      const chunk& part = *changes[chunk_at];
+      change_at = partition_point (part.begin(), part.end(),
+                                   entry_before) - part.begin();
+   }
+   settle();
+}
+
+// change, next_change -
+//    The change the walk is at, or nullptr past the last, and the
+//    step to the one after it.
+
+const dirent_version::entry*
+dirent_version::const_iterator::change() const {
+   const auto& changes = version->changes;
+   if (chunk_at == changes.size()) return nullptr;
+   return &(*changes[chunk_at])[change_at];
+}
+
+void dirent_version::const_iterator::next_change() {
+   if (++change_at == version->changes[chunk_at]->size()) {
+      ++chunk_at;
+      change_at = 0;
+   }
+}
+
+// settle -
+//    Skips the entries of the base that were removed or replaced,
+//    then points at whichever of the base and the changes comes
+//    first by name.  A removal always has a base entry of its name,
+//    so a change that comes first adds an entry.
+
+void dirent_version::const_iterator::settle() {
+   const vector<entry>& base = version->base->entries;
+   for (;;) {
+      const entry* next = change();
+      const entry* kept = base_at < base.size() ? &base[base_at]
+                                                : nullptr;
+      if (next != nullptr and kept != nullptr
+          and next->first == kept->first) {
+         ++base_at;
+         if (next->second == nullptr) {
+            next_change();
+            continue;
+         }
+         kept = nullptr;
+      }
+      from_change = next != nullptr
+                    and (kept == nullptr
+                         or name_table::less (next->first,
+                                              kept->first));
+      at = from_change ? next : kept;
+      return;
+   }
+}
+
+dirent_version::const_iterator&
+dirent_version::const_iterator::operator++() {
+   if (from_change) next_change();
+   else ++base_at;
+   settle();
+   return *this;
+}
+
@@ -0,0 +1,210 @@
+// $Id: dirents.h,v 1.2 2026-10-17 12:00:00-07 - - $
+
+// dirent_table -
+//    The container a directory uses to map interned names onto
+//    inodes.  Small directories keep their entries in a contiguous
+//    vector sorted by name, which is scanned for the name id.  Once
+//    a directory grows past small_limit entries, an open-addressing
+//    hash index is built over the vector, new entries are appended
+//    unsorted, and the vector is put back in order lazily when it is
+//    next walked.
+//    Iteration is always in lexicographic order, so ls prints the
+//    same either way.  Entries hold plain pointers; what keeps an
+//    inode alive is up to the directory.
+// find -
+//    Returns the inode for a name id, or nullptr if there is none.
+// assign -
+//    Inserts a new entry, or replaces the inode of an existing one.
+// erase -
+//    Removes an entry and returns whether it was present.
+// from_sorted -
+//    Makes a table of entries that are already in order, building
+//    the index once.
+// seal -
+//    Does the lazy sorting now.  A sealed table changes nothing when
+//    it is read, so any number of threads may read it at once.
+//
+// dirent_version -
+//    One published state of a directory's entries, which is never
+//    changed once made:  assign and erase return the next version.
+//    A version is a sealed dirent_table, shared with the versions
+//    before and after it, plus the changes made since, sorted by
+//    name:  entries added or replaced, and base entries removed,
+//    which hold a null inode.  The changes are kept in chunks of at
+//    most 2 * chunk_size, each shared by every version that has it,
+//    so a new version copies the chunk pointers and the one chunk it
+//    changes, not every change.  Lookups find the chunk by name and
+//    scan it by id before trying the table's index, and walks merge
+//    the two in order.  Once the changes outgrow about
+//    sqrt (chunk_size * n), they are folded into a new table, which
+//    keeps both the chunk pointers copied and the entries folded per
+//    change near sqrt (n / chunk_size).
+// lower_bound -
+//    Starts a walk at the first entry whose name is not before the
+//    given text, found by binary search in the table and the changes,
+//    so that a range of names can be walked without the rest.
+
+#ifndef __DIRENTS_H__
+#define __DIRENTS_H__
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+using namespace std;
+
+#include "names.h"
+
+class inode;
+
+class dirent_table {
+   friend class dirent_version;
+   public:
+      using entry = pair<name_id,inode*>;
+      class const_iterator {
+         friend class dirent_table;
+         private:
+            const dirent_table* table {nullptr};
+            size_t rank {0};
+            const_iterator (const dirent_table* tab, size_t pos):
+                            table (tab), rank (pos) {}
+         public:
+            using iterator_category = bidirectional_iterator_tag;
+            using value_type = entry;
+            using difference_type = ptrdiff_t;
+            using pointer = const entry*;
+            using reference = const entry&;
+            const_iterator() = default;
+            reference operator*() const {
+               return table->entries[rank];
+            }
+            pointer operator->() const { return &**this; }
+            const_iterator& operator++() { ++rank; return *this; }
+            const_iterator& operator--() { --rank; return *this; }
+            const_iterator operator++ (int) {
+               const_iterator old = *this; ++rank; return old;
+            }
+            const_iterator operator-- (int) {
+               const_iterator old = *this; --rank; return old;
+            }
+            bool operator== (const const_iterator& that) const {
+               return rank == that.rank;
+            }
+            bool operator!= (const const_iterator& that) const {
+               return rank != that.rank;
+            }
+      };
+      using const_reverse_iterator = reverse_iterator<const_iterator>;
+
+      size_t size() const { return entries.size(); }
+      bool empty() const { return entries.empty(); }
+      inode* find (name_id name) const;
+      bool contains (name_id name) const;
+      void assign (name_id name, inode* node);
+      bool erase (name_id name);
+      void clear();
+      void seal() const { if (hashed()) sort_view(); }
+      static dirent_table from_sorted (vector<entry> ordered);
+      const_iterator begin() const;
+      const_iterator end() const;
+      const_reverse_iterator rbegin() const {
+         return const_reverse_iterator (end());
+      }
+      const_reverse_iterator rend() const {
+         return const_reverse_iterator (begin());
+      }
+
+   private:
+      static constexpr size_t small_limit {16};
+      static constexpr uint32_t empty_slot {0};
+      // The vector is reordered by sort_view, which is const because
+      // it changes neither the contents nor the iteration order.
+      mutable vector<entry> entries;
+      mutable vector<uint32_t> slots;  // entry index + 1, or empty_slot
+      mutable size_t sorted {0};       // length of sorted prefix
+      bool hashed() const { return not slots.empty(); }
+      static size_t hash (name_id name) {
+         return static_cast<uint64_t> (name) * 0x9E3779B97F4A7C15u
+                >> 32;
+      }
+      size_t small_find (name_id name) const;
+      size_t slot_of (name_id name) const;
+      void place (uint32_t index) const;
+      void rehash (size_t capacity) const;
+      void to_hashed();
+      void to_small();
+      void sort_view() const;
+};
+
+class dirent_version {
+   public:
+      using entry = dirent_table::entry;
+      class const_iterator {
+         friend class dirent_version;
+         private:
+            const dirent_version* version {nullptr};
+            size_t base_at {0};
+            size_t chunk_at {0};
+            size_t change_at {0};       // within the chunk
+            const entry* at {nullptr};  // nullptr at the end
+            bool from_change {false};
+            const_iterator (const dirent_version* ver);
+            const_iterator (const dirent_version* ver,
+                            string_view from);
+            const entry* change() const;
+            void next_change();
+            void settle();
+         public:
+            using iterator_category = forward_iterator_tag;
+            using value_type = entry;
+            using difference_type = ptrdiff_t;
+            using pointer = const entry*;
+            using reference = const entry&;
+            const_iterator() = default;
+            reference operator*() const { return *at; }
+            pointer operator->() const { return at; }
+            const_iterator& operator++();
+            const_iterator operator++ (int) {
+               const_iterator old = *this; ++*this; return old;
+            }
+            bool operator== (const const_iterator& that) const {
+               return at == that.at;
+            }
+            bool operator!= (const const_iterator& that) const {
+               return at != that.at;
+            }
+      };
+
+      explicit dirent_version (dirent_table table);
+      size_t size() const { return count; }
+      bool empty() const { return count == 0; }
+      inode* find (name_id name) const;
+      bool contains (name_id name) const {
+         return find (name) != nullptr;
+      }
+      unique_ptr<dirent_version> assign (name_id name,
+                                         inode* node) const;
+      unique_ptr<dirent_version> erase (name_id name) const;
+      const_iterator begin() const { return const_iterator (this); }
+      const_iterator end() const { return const_iterator(); }
+      const_iterator lower_bound (string_view name) const {
+         return const_iterator (this, name);
+      }
+
+   private:
+      using chunk = vector<entry>;
+      static constexpr size_t chunk_size {64};
+      shared_ptr<const dirent_table> base;
+      vector<shared_ptr<const chunk>> changes;  // by name, none empty
+      size_t change_count {0};
+      size_t count {0};
+      size_t chunk_of (name_id name) const;
+      const entry* find_change (name_id name) const;
+      inode* set_change (name_id name, inode* node);
+      void fold_if_due();
+};
+
+#endif
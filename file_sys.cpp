@@ -1,15 +1,33 @@
 // $Id: file_sys.cpp,v 1.7 2019-07-09 14:05:44-07 - - $
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <mutex>
 #include <stdexcept>
 #include <unordered_map>
-#include <iomanip>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
 using namespace std;
 
 #include "debug.h"
 #include "file_sys.h"
+#include "glob.h"
+#include "history.h"
+#include "mapfile.h"
+#include "rcu.h"
+#include "reclaim.h"
+#include "snapshot.h"
+#include "slab.h"
+#include "stats.h"
+#include "trace.h"
+#include "wordindex.h"
+#include "workpool.h"
 
-int inode::next_inode_nr {0};
+atomic<unsigned> directory::path_generation {1};
 
 struct file_type_hash {
    size_t operator() (file_type type) const {
@@ -25,42 +43,184 @@ ostream& operator<< (ostream& out, file_type type) {
    return out << hash[type];
 }
 
-inode_state::inode_state() {
-  DEBUGF ('i', "root = " << root << ", cwd = " << cwd
+// inode_state::shared_tree -
+//    What the sessions on one tree have in common.  generation moves
+//    whenever a cached lookup may have gone stale.  sessions lists
+//    the states on the tree, so that rmr and load can move a cwd out
+//    of a subtree they take away.  The root is owned by its link, and
+//    readers load it without the tree lock.  The history outlives the
+//    root's link, and lets go of what it keeps when it goes.  The
+//    word index is every directory's search_index.
+
+struct inode_state::shared_tree {
+   tree_history history;
+   word_index index;
+   atomic<inode*> root {nullptr};
+   journal* log {nullptr};
+   shared_mutex lock;
+   atomic<unsigned> generation {0};
+   mutex sessions_lock;
+   vector<inode_state*> sessions;
+   ~shared_tree() {reclaimer::shared().retire(move(root.load()->link));}
+};
+
+inode_state::inode_state(): tree_ (make_shared<shared_tree>()) {
+  DEBUGF ('i', "root = " << tree_->root << ", cwd = " << cwd
           << ", prompt = \"" << prompt() << "\"");
 
-   root = make_shared<inode>(file_type::DIRECTORY_TYPE);
-   inode_ptr temp = root;
-   root = root->contents->mkdir("/");
-   temp = nullptr;
-   cwd = root;
+   // / has always been inode 1.
+   inode_ptr top = inode::make(file_type::DIRECTORY_TYPE,
+                               tree_->history.new_inode_nr());
+   directory& dir = static_cast<directory&>(*top->contents);
+   dir.start(top.get(), nullptr);
+   dir.currName = name_table::intern("/");
+   dir.history = &tree_->history;
+   dir.search_index = &tree_->index;
+   top->link = top;
+   tree_->root = top.get();
+   cwd = top;
+   join();
+}
+inode_state::inode_state(tree_ptr shared): tree_ (move(shared)) {
+   shared_lock<shared_mutex> guard(tree_->lock);
+   cwd = tree_->root.load()->link;
+   join();
 }
 inode_state::~inode_state(){
-  root->contents->rmr();
+   lock_guard<mutex> guard(tree_->sessions_lock);
+   auto& sessions = tree_->sessions;
+   sessions.erase(find(sessions.begin(), sessions.end(), this));
+}
+
+void inode_state::join(){
+   // The tree is locked, so no rmr or load can miss this cwd.
+   lock_guard<mutex> guard(tree_->sessions_lock);
+   tree_->sessions.push_back(this);
+}
+
+// settle -
+//    Done first in every command, inside its read-side section:  takes
+//    any move of the cwd posted by another session, and drops cached
+//    lookups if an entry has been removed since the last command.
+//    The section began before either is looked at, so nothing the
+//    cache or the old cwd could reach is freed while it lasts.
+
+void inode_state::settle(){
+   if(moved.load(memory_order_acquire)){
+      lock_guard<mutex> guard(cwd_lock);
+      cwd = move(moved_to);
+      moved.store(false, memory_order_relaxed);
+   }
+   unsigned gen = tree_->generation.load(memory_order_acquire);
+   if(gen != dentry_gen){
+      dentries.clear();
+      dentry_gen = gen;
+   }
+}
+
+void inode_state::set_cwd(inode_ptr dir){
+   lock_guard<mutex> guard(cwd_lock);
+   cwd = move(dir);
+   moved_to = nullptr;
+   moved.store(false, memory_order_relaxed);
+}
+
+// relocate -
+//    Posts a move to to every session whose cwd is gone or below it,
+//    or to every session if gone is nullptr.  The tree is held alone,
+//    so no session changes its cwd meanwhile, and the cwd of each is
+//    taken as where it is bound for if it has a move pending.
+
+void inode_state::relocate(const inode* gone, inode* to){
+   relocate_where([gone](const inode* where){
+      return gone == nullptr || is_ancestor(gone, where);
+   }, to);
+}
+
+void inode_state::relocate_where(function<bool(const inode*)> gone,
+                                 inode* to){
+   lock_guard<mutex> sessions_guard(tree_->sessions_lock);
+   for(inode_state* session: tree_->sessions){
+      lock_guard<mutex> guard(session->cwd_lock);
+      const inode* where = session->moved.load(memory_order_relaxed)
+                         ? session->moved_to.get()
+                         : session->cwd.get();
+      if(gone(where)){
+         session->moved_to = to->link;
+         session->moved.store(true, memory_order_release);
+      }
+   }
+}
+
+void inode_state::invalidate(){
+   dentries.clear();
+   dentry_gen = ++tree_->generation;
+}
+
+void inode_state::record(journal_op op,
+                         initializer_list<string_view> args,
+                         wordspan words){
+   if(tree_->log == nullptr)
+      return;
+   try {
+      tree_->log->append(op, args, words);
+   }catch (journal_error& error) {
+      complain() << "journal: " << error.what() << endl;
+   }
+}
+
+void inode_state::attach(journal* journal_){
+   tree_->log = journal_;
+}
+
+directory& inode_state::cwd_dir(){
+   return static_cast<directory&>(*cwd->contents);
 }
 
 const string& inode_state::prompt() const { return prompt_; }
 
 ostream& operator<< (ostream& out, const inode_state& state) {
-   out << "inode_state: root = " << state.root
+   out << "inode_state: root = " << state.tree_->root.load()
        << ", cwd = " << state.cwd;
    return out;
 }
 
-inode::inode(file_type type): inode_nr (next_inode_nr++) {
+// inode_with -
+//    An inode with its contents stored inline after it.
+
+template <typename payload_t>
+class inode_with: public inode {
+   private:
+      payload_t payload;
+   public:
+      inode_with (file_type type, int number):
+                  inode (type, &payload, number) {}
+};
+
+inode::inode(file_type type, base_file_ptr payload, int number):
+             inode_nr (number), born (tree_history::epoch()),
+             contents (payload) {
+   this_type = type;
+   stats::count (counter::INODES_MADE);
+   TRACE ('i', "made", inode_nr);
+   DEBUGF ('i', "inode " << inode_nr << ", type = " << type);
+}
+inode_ptr inode::make(file_type type, int number){
    switch (type) {
       case file_type::PLAIN_TYPE:
-           contents = make_shared<plain_file>();
-           break;
+           return allocate_shared<inode_with<plain_file>>
+                  (slab_allocator<inode_with<plain_file>>(), type,
+                   number);
       case file_type::DIRECTORY_TYPE:
-           contents = make_shared<directory>();
-           break;
+           return allocate_shared<inode_with<directory>>
+                  (slab_allocator<inode_with<directory>>(), type,
+                   number);
    }
-   this_type = type;
-   DEBUGF ('i', "inode " << inode_nr << ", type = " << type);
+   throw file_error ("invalid file type");
 }
 inode::~inode(){
-
+  stats::count (counter::INODES_FREED);
+  TRACE ('i', "freed", inode_nr);
   contents = nullptr;
 }
 int inode::get_inode_nr() const {
@@ -68,7 +228,8 @@ int inode::get_inode_nr() const {
    return inode_nr;
 }
 directory::~directory(){
-  dirents.clear();
+  delete dirents.load();
+  delete path_cache.load();
 }
 
 
@@ -76,11 +237,11 @@ file_error::file_error (const string& what):
             runtime_error (what) {
 }
 
-const wordvec& base_file::readfile() const {
+const file_content& base_file::readfile() const {
    throw file_error ("is a " + error_file_type());
 }
 
-void base_file::writefile (const wordvec&) {
+void base_file::writefile (wordspan) {
    throw file_error ("is a " + error_file_type());
 }
 
@@ -93,76 +254,204 @@ inode_ptr base_file::mkdir (const string&) {
    
 }
 
-inode_ptr base_file::mkfile (const string&) {
+inode_ptr base_file::mkfile (const string&, wordspan) {
    throw file_error ("is a " + error_file_type());
 }
 
 
 size_t plain_file::size() const {
-   size_t size {0};
-   auto i = data.begin();
+   return data.size();
+}
 
-   while(i != data.end()){
-      size += i->length();
-      ++i;
-   }
-   if(size > 0)
-     size += data.size() -1 ;
-   return size;
+subtree_totals plain_file::usage() const {
+   return {1, 0, data.size()};
 }
 
-const wordvec& plain_file::readfile() const {
-   
+const file_content& plain_file::readfile() const {
    return data;
 }
 
-void plain_file::writefile (const wordvec& words) {
+void plain_file::writefile (wordspan words) {
    DEBUGF ('i', words);
-   wordvec newFile;
-   newFile = words;
-   while(newFile.size() >2){
-      data.push_back(newFile.back());
-      newFile.pop_back();
-   }
+   if(parent != nullptr)
+      parent->sub_usage({0, 0, data.size()});
+   data.assign (words);
+   image = nullptr;
+   if(parent != nullptr)
+      parent->add_usage({0, 0, data.size()});
 }
 
 size_t directory::size() const {
-   size_t size {0};
-   size = dirents.size();
+   size_t size = entry_count.load(memory_order_relaxed);
    DEBUGF ('i', "size = " << size);
    return size;
 }
 
+subtree_totals directory::usage() const {
+   subtree_totals result = totals.load();
+   ++result.dirs;
+   return result;
+}
+
+void directory::add_usage(const subtree_totals& delta){
+   for(directory* d = this; d != nullptr; d = d->parent){
+      if(d->history != nullptr)
+         d->history->preserve(*d);
+      d->totals.files.fetch_add(delta.files, memory_order_relaxed);
+      d->totals.dirs.fetch_add(delta.dirs, memory_order_relaxed);
+      d->totals.bytes.fetch_add(delta.bytes, memory_order_relaxed);
+   }
+}
+
+void directory::sub_usage(const subtree_totals& delta){
+   for(directory* d = this; d != nullptr; d = d->parent){
+      if(d->history != nullptr)
+         d->history->preserve(*d);
+      d->totals.files.fetch_sub(delta.files, memory_order_relaxed);
+      d->totals.dirs.fetch_sub(delta.dirs, memory_order_relaxed);
+      d->totals.bytes.fetch_sub(delta.bytes, memory_order_relaxed);
+   }
+}
+
+const dirent_version& directory::entries(){
+   if(unexpanded.load(memory_order_acquire)){
+      lock_guard<mutex> guard(lock);
+      if(unexpanded.load(memory_order_relaxed))
+         expand();
+   }
+   return *dirents.load(memory_order_acquire);
+}
+
+unique_lock<mutex> directory::writing(){
+   unique_lock<mutex> guard(lock);
+   if(unexpanded.load(memory_order_relaxed))
+      expand();
+   return guard;
+}
+
+void directory::publish(unique_ptr<dirent_version> next){
+   if(history != nullptr)
+      history->preserve(*this);
+   replace_table(move(next));
+}
+
+void directory::replace_table(unique_ptr<dirent_version> next){
+   entry_count.store(next->size(), memory_order_relaxed);
+   const dirent_version* old = dirents.exchange(next.release(),
+                                                memory_order_acq_rel);
+   if(old != nullptr)
+      rcu::retire([old] { delete old; });
+}
+
+void directory::start(inode* self, inode* up){
+   dirent_table first;
+   first.assign(name_table::dot, self);
+   first.assign(name_table::dotdot, up != nullptr ? up : self);
+   publish(make_unique<dirent_version>(move(first)));
+}
+
+// let_go -
+//    Settles up for an inode just taken out of the table.  Its
+//    parent pointer is left alone, so that a reader still inside it
+//    can find its path until it is freed.
+
+void directory::let_go(inode* node){
+   sub_usage(node->contents->usage());
+   if(search_index != nullptr && search_index->enabled())
+      unindex(node);
+   if(history == nullptr || !history->keep(node->link))
+      release(move(node->link));
+}
+
+void directory::unindex(inode* node){
+   // A directory still only in its snapshot has nothing indexed.
+   vector<inode*> nodes {node};
+   while(!nodes.empty()){
+      inode* each = nodes.back();
+      nodes.pop_back();
+      if(each->this_type != file_type::DIRECTORY_TYPE){
+         search_index->remove(each->inode_nr,
+                              each->contents->readfile());
+         continue;
+      }
+      directory& dir = static_cast<directory&>(*each->contents);
+      if(dir.unexpanded)
+         continue;
+      for(const auto& entry: dir.entries())
+         if(entry.first != name_table::dot
+            && entry.first != name_table::dotdot)
+            nodes.push_back(entry.second);
+   }
+}
+
+void directory::release(inode_ptr link){
+   if(link->this_type == file_type::DIRECTORY_TYPE){
+      reclaimer::shared().retire(move(link));
+   }else{
+      // The file dies with the function, after the grace period.
+      rcu::retire([gone = move(link)] {});
+   }
+}
+
 void directory::remove (const string& filename) { 
-   dirents.erase(filename);
+   name_id id = name_table::find(filename);
+   inode* node = entries().find(id);
+   if(node == nullptr)
+      return;
+   publish(entries().erase(id));
+   let_go(node);
 }
 
 inode_ptr directory::mkdir (const string& dirname) {
-   if(contains(dirname)){
-      cout << "directory already exists" << endl;
+   const dirent_version& table = entries();
+   if(table.contains(name_table::find(dirname))){
+      output() << "directory already exists" << '\n';
       return nullptr;
    }
    
-   inode_ptr n = make_shared<inode>(file_type::DIRECTORY_TYPE);
+   inode_ptr n = inode::make(file_type::DIRECTORY_TYPE,
+                             history->new_inode_nr());
+   directory& child = static_cast<directory&>(*n->contents);
+   child.start(n.get(), table.find(name_table::dot));
+   // A new directory has no cached path, so no others go stale.
+   child.currName = name_table::intern(dirname);
+   child.parent = this;
+   child.history = history;
+   child.search_index = search_index;
    add_entry(dirname,n);
-   n->contents->add_entry(".",n);
-   if(dirname.compare("/") == 0)
-      n->contents->add_entry("..",n);
-   else
-      n->contents->add_entry("..",dirents["."]);
+   add_usage(child.usage());
 
    DEBUGF ('i', dirname);
-   n->contents->changeName(dirname);
    return n;
 }
 
-inode_ptr directory::mkfile (const string& filename) {
-   inode_ptr n = make_shared<inode>(file_type::PLAIN_TYPE);
-   add_entry(filename,n);
+inode_ptr directory::mkfile (const string& filename, wordspan words) {
+   // The text is written before the file is published, so no reader
+   // sees it empty, and the old file goes in the same change.
+   inode_ptr n = inode::make(file_type::PLAIN_TYPE,
+                             history->new_inode_nr());
+   n->contents->writefile(words);
+   add_file(filename, n);
    return n;
 }
+
+void directory::add_file (const string& filename, inode_ptr n) {
+   name_id id = name_table::intern(filename);
+   n->contents->currName = id;
+   n->contents->parent = this;
+   n->link = n;
+   if(search_index != nullptr)
+      search_index->add(n->inode_nr, n.get(),
+                        n->contents->readfile());
+   inode* old = entries().find(id);
+   publish(entries().assign(id, n.get()));
+   if(old != nullptr)
+      let_go(old);
+   add_usage(n->contents->usage());
+}
 void directory::add_entry(const string& key, inode_ptr value) {
-   dirents[key] = value;
+   value->link = value;
+   publish(entries().assign(name_table::intern(key), value.get()));
 }
 
 void plain_file::add_entry(const string&, inode_ptr) {
@@ -170,221 +459,1055 @@ void plain_file::add_entry(const string&, inode_ptr) {
 }
 
 void directory::changeName(const string name){
-   this->currName= name;
+   this->currName= name_table::intern(name);
+   ++path_generation;
 }
 
 void plain_file::changeName(const string name){
-   this->currName = name;
+   this->currName = name_table::intern(name);
 }
 
 void base_file::changeName(const string name){
-   this->currName = name;
+   this->currName = name_table::intern(name);
 }
 
 string inode_state::getName(){
     return cwd->contents->getName();
 }
 string inode_state::getDir(){
-   string output ="";
-   inode_ptr s = cwd;
-   if (root == cwd)
-      return root->contents->getName();
-   while(root != cwd){
-      output = "/" + cwd->contents->getName() + output;
-      cwd = cwd->contents->get("..");
-   }
-   cwd = s;
-   return output;
+   rcu_reader section;
+   settle();
+   return cwd->contents->path();
 }
 void inode_state::mkdir(const string& str){
-   cwd->contents->mkdir(str);
+   rcu_reader section;
+   shared_lock<shared_mutex> guard(tree_->lock);
+   settle();
+   directory& dir = cwd_dir();
+   auto dir_guard = dir.writing();
+   if(dir.mkdir(str) != nullptr)
+      record(journal_op::MKDIR, {dir.path(), str});
 }
-void inode_state::mkfile(const wordvec& words){
-   inode_ptr newFile = cwd->contents->mkfile(words[1]);
-   newFile->contents->writefile(words);
-
+void inode_state::mkfile(const string& name, wordspan words){
+   rcu_reader section;
+   shared_lock<shared_mutex> guard(tree_->lock);
+   settle();
+   directory& dir = cwd_dir();
+   auto dir_guard = dir.writing();
+   inode* old = dir.entries().find(name_table::find(name));
+   if(old != nullptr && old->this_type == file_type::DIRECTORY_TYPE){
+      output() << "make: " << name << ": Is a directory" << '\n';
+      return;
+   }
+   if(old != nullptr)
+      invalidate();
+   dir.mkfile(name, words);
+   record(journal_op::MAKE, {dir.path(), name}, words);
+}
+void inode_state::changePrompt(const string& str){
+   prompt_ = str;
+   record(journal_op::PROMPT, {str});
 }
 void inode_state::cd(const string& str){
-   inode_ptr temp = root->contents->find(str);
-   if(cwd->contents->contains(str) &&
-      cwd->contents->get(str)->this_type == file_type::DIRECTORY_TYPE)
-      cwd = cwd->contents->get(str);
-   else if(temp != nullptr && temp->this_type 
-           == file_type::DIRECTORY_TYPE)
-      cwd = temp;
+   // The tree lock keeps rmr from taking the new cwd away before
+   // it is seen.
+   rcu_reader section;
+   shared_lock<shared_mutex> guard(tree_->lock);
+   settle();
+   inode* temp = resolve(str);
+   if(temp != nullptr && temp->this_type == file_type::DIRECTORY_TYPE)
+      set_cwd(temp->link);
    else
-      cout << " no directory found" << endl;
-  
+      output() << " no directory found" << '\n';
 }
-bool directory::contains(const string& name){
-   try{
-      dirents.at(name);
-      return true;
-    }
-   catch(const std::out_of_range& oor){
+inode* inode_state::resolve(const string& path){
+   inode* node = path.size() > 0 && path[0] == '/'
+               ? tree_->root.load(memory_order_acquire) : cwd.get();
+   dentry_key key {node->get_inode_nr(), path};
+   stats::count (counter::LOOKUPS);
+   auto hit = dentries.find(key);
+   if(hit != dentries.end()){
+      stats::count (counter::LOOKUP_HITS);
+      TRACE ('l', "hit", path.size());
+      return hit->second;
+   }
+   for(const string& name: split(path, "/")){
+      if(node->this_type != file_type::DIRECTORY_TYPE)
+         return nullptr;
+      node = node->contents->get(name);
+      if(node == nullptr)
+         return nullptr;
+   }
+   TRACE ('l', "walked", path.size());
+   if(dentries.size() >= dentry_limit)
+      invalidate();
+   dentries.emplace(key, node);
+   return node;
+}
+vector<string> inode_state::glob(const string& path){
+   if(!glob_pattern::is_pattern(path))
+      return {path};
+   rcu_reader section;
+   settle();
+   bool absolute = path.size() > 0 && path[0] == '/';
+   vector<pair<inode*,string>> found {{
+      absolute ? tree_->root.load(memory_order_acquire) : cwd.get(),
+      absolute ? "/" : ""}};
+   auto join = [](const string& dir, const string& name){
+      if(dir.empty() || dir.back() == '/')
+         return dir + name;
+      return dir + "/" + name;
+   };
+   for(const string& part: split(path, "/")){
+      vector<pair<inode*,string>> next;
+      if(!glob_pattern::is_pattern(part)){
+         for(const auto& [node, text]: found){
+            inode* child = node->this_type == file_type::DIRECTORY_TYPE
+                         ? node->contents->get(part) : nullptr;
+            if(child != nullptr)
+               next.push_back({child, join(text, part)});
+         }
+      }else {
+         glob_pattern pattern(part);
+         const string& prefix = pattern.prefix();
+         for(const auto& [node, text]: found){
+            if(node->this_type != file_type::DIRECTORY_TYPE)
+               continue;
+            const dirent_version& table =
+                  static_cast<directory&>(*node->contents).entries();
+            for(auto entry = table.lower_bound(prefix);
+                entry != table.end(); ++entry){
+               const string& name = name_table::name(entry->first);
+               if(name.compare(0, prefix.size(), prefix) != 0)
+                  break;
+               if(pattern.matches(name))
+                  next.push_back({entry->second, join(text, name)});
+            }
+         }
+      }
+      found = move(next);
+   }
+   if(found.empty())
+      return {path};
+   vector<string> paths;
+   for(auto& each: found)
+      paths.push_back(move(each.second));
+   return paths;
+}
+
+// reindex -
+//    Builds the word index again from every file in the tree.  The
+//    caller holds the tree lock alone.
+
+void inode_state::reindex(){
+   vector<indexed_file> files;
+   vector<directory*> v {
+      static_cast<directory*>(tree_->root.load()->contents)};
+   while(!v.empty()){
+      directory& d = *v.back();
+      v.pop_back();
+      for(const auto& entry: d.entries()){
+         if(entry.first == name_table::dot
+            || entry.first == name_table::dotdot)
+            continue;
+         inode* node = entry.second;
+         if(node->this_type == file_type::DIRECTORY_TYPE)
+            v.push_back(static_cast<directory*>(node->contents));
+         else
+            files.push_back({node->inode_nr, node,
+                             &node->contents->readfile()});
+      }
+   }
+   tree_->index.rebuild(move(files));
+}
+
+void inode_state::index(bool on){
+   rcu_reader section;
+   unique_lock<shared_mutex> guard(tree_->lock);
+   settle();
+   if(on == tree_->index.enabled())
+      return;
+   tree_->index.enable(on);
+   if(on)
+      reindex();
+}
+
+void inode_state::index_usage(){
+   rcu_reader section;
+   shared_lock<shared_mutex> guard(tree_->lock);
+   settle();
+   if(!tree_->index.enabled()){
+      output() << "index: off" << '\n';
+      return;
+   }
+   word_index_usage usage = tree_->index.usage();
+   output() << "index: on, " << usage.files << " files, "
+            << usage.words << " words, " << usage.bytes
+            << " bytes of postings" << '\n';
+}
+
+void inode_state::search(const string& word){
+   rcu_reader section;
+   shared_lock<shared_mutex> guard(tree_->lock);
+   settle();
+   if(!tree_->index.enabled()){
+      output() << "search: index is off" << '\n';
+      return;
+   }
+   // Every file found is linked in the tree, and so is its parent.
+   for(const inode* node: tree_->index.find(word)){
+      const plain_file& file =
+            static_cast<const plain_file&>(*node->contents);
+      const string& dir = file.parent->path();
+      output() << dir << (dir == "/" ? "" : "/")
+               << name_table::name(file.currName) << '\n';
+   }
+}
+
+inode_ptr inode_state::read_host(const string& host){
+   mapped_file text(host);
+   if(text.size() > UINT32_MAX)
+      throw mapping_error(host + ": " + strerror(EFBIG));
+   inode_ptr file = inode::make(file_type::PLAIN_TYPE,
+                                tree_->history.new_inode_nr());
+   static_cast<plain_file&>(*file->contents).data.assign_text(
+         text.view(), [&text](size_t from, size_t to){
+            text.release(from, to);
+         });
+   return file;
+}
+
+void inode_state::add_host(const string& path, inode_ptr file,
+                           const string& host){
+   rcu_reader section;
+   shared_lock<shared_mutex> guard(tree_->lock);
+   settle();
+   string name;
+   inode* parent = resolve(path);
+   if(parent != nullptr
+      && parent->this_type == file_type::DIRECTORY_TYPE)
+      name = filesystem::path(host).filename().string();
+   else
+      parent = resolve_parent(path, name);
+   if(parent == nullptr
+      || parent->this_type != file_type::DIRECTORY_TYPE
+      || name.empty() || name == "." || name == ".."){
+      output() << "import: " << path
+               << ": No such file or directory" << '\n';
+      return;
+   }
+   directory& dir = static_cast<directory&>(*parent->contents);
+   auto dir_guard = dir.writing();
+   inode* old = dir.entries().find(name_table::find(name));
+   if(old != nullptr && old->this_type == file_type::DIRECTORY_TYPE){
+      output() << "import: " << path << ": Is a directory" << '\n';
+      return;
+   }
+   if(old != nullptr)
+      invalidate();
+   dir.add_file(name, move(file));
+   record(journal_op::IMPORT, {dir.path(), name,
+                               filesystem::absolute(host).string()});
+}
+
+bool inode_state::make_dir(const string& path){
+   rcu_reader section;
+   shared_lock<shared_mutex> guard(tree_->lock);
+   settle();
+   inode* node = resolve(path);
+   if(node != nullptr)
+      return node->this_type == file_type::DIRECTORY_TYPE;
+   string name;
+   inode* parent = resolve_parent(path, name);
+   if(parent == nullptr
+      || parent->this_type != file_type::DIRECTORY_TYPE)
       return false;
+   directory& dir = static_cast<directory&>(*parent->contents);
+   auto dir_guard = dir.writing();
+   if(dir.mkdir(name) == nullptr)
+      return false;
+   record(journal_op::MKDIR, {dir.path(), name});
+   return true;
+}
+
+void inode_state::import_host(const string& host, const string& path,
+                              bool recursive){
+   if(!filesystem::is_directory(host)){
+      add_host(path, read_host(host), host);
+      return;
+   }
+   if(!recursive){
+      output() << "import: " << host << ": Is a directory" << '\n';
+      return;
+   }
+   // Directories come before what is in them.
+   if(!make_dir(path)){
+      output() << "import: " << path << ": Not a directory" << '\n';
+      return;
+   }
+   string top = path.empty() || path.back() == '/' ? path : path + "/";
+   for(const auto& entry:
+       filesystem::recursive_directory_iterator(host)){
+      string below = top + entry.path().lexically_relative(host)
+                                       .generic_string();
+      if(entry.is_symlink())
+         continue;
+      if(entry.is_directory()){
+         if(!make_dir(below))
+            output() << "import: " << below << ": Not a directory"
+                     << '\n';
+      }else if(entry.is_regular_file()){
+         add_host(below, read_host(entry.path().string()),
+                  entry.path().string());
+      }
    }
 }
-inode_ptr directory::get(const string& name){
-   return dirents[name];
+
+// write_host -
+//    Writes a file's text to a host file straight from where it is
+//    kept, and a newline after it if it is not empty, with writev.
+
+static void write_host(const string& filename, string_view text){
+   int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+   if(fd < 0)
+      throw file_error(filename + ": " + strerror(errno));
+   char newline = '\n';
+   iovec parts[] {{const_cast<char*>(text.data()), text.size()},
+                  {&newline, text.empty() ? 0u : 1u}};
+   iovec* next = parts;
+   int left = 2;
+   while(left > 0){
+      ssize_t wrote = writev(fd, next, left);
+      if(wrote < 0){
+         if(errno == EINTR)
+            continue;
+         int error = errno;
+         close(fd);
+         throw file_error(filename + ": " + strerror(error));
+      }
+      for(; left > 0 && size_t(wrote) >= next->iov_len; --left)
+         wrote -= next++->iov_len;
+      if(left > 0){
+         next->iov_base = static_cast<char*>(next->iov_base) + wrote;
+         next->iov_len -= wrote;
+      }
+   }
+   if(close(fd) < 0)
+      throw file_error(filename + ": " + strerror(errno));
 }
 
-bool base_file::contains(const string&){
+void inode_state::export_host(const string& path, const string& host,
+                              bool recursive){
+   rcu_reader section;
+   settle();
+   inode* p = resolve(path);
+   if(p == nullptr){
+      output() << "export: " << path
+               << ": No such file or directory" << '\n';
+      return;
+   }
+   if(p->this_type != file_type::DIRECTORY_TYPE){
+      filesystem::path to = host;
+      if(filesystem::is_directory(to))
+         to /= p->contents->getName();
+      write_host(to.string(), p->contents->readfile().text());
+      return;
+   }
+   if(!recursive){
+      output() << "export: " << path << ": Is a directory" << '\n';
+      return;
+   }
+   filesystem::create_directories(host);
+   vector<pair<directory*,filesystem::path>> v {
+      {static_cast<directory*>(p->contents), host}};
+   while(!v.empty()){
+      auto [d, to] = move(v.back());
+      v.pop_back();
+      for(const auto& entry: d->entries()){
+         if(entry.first == name_table::dot
+            || entry.first == name_table::dotdot)
+            continue;
+         filesystem::path below = to / name_table::name(entry.first);
+         inode* node = entry.second;
+         if(node->this_type == file_type::DIRECTORY_TYPE){
+            filesystem::create_directory(below);
+            v.push_back({static_cast<directory*>(node->contents),
+                         below});
+         }else {
+            write_host(below.string(),
+                       node->contents->readfile().text());
+         }
+      }
+   }
+}
+inode* inode_state::resolve_parent(const string& path, string& name){
+   size_t slash = path.find_last_of('/');
+   if(slash == string::npos){
+      name = path;
+      return cwd.get();
+   }
+   name = path.substr(slash + 1);
+   if(slash == 0)
+      return tree_->root.load(memory_order_acquire);
+   return resolve(path.substr(0, slash));
+}
+bool inode_state::is_ancestor(const inode* dir, const inode* node){
+   const directory* d = &static_cast<directory&>(*node->contents);
+   while(d != nullptr){
+      if(d == dir->contents)
+         return true;
+      d = d->get_parent();
+   }
+   return false;
+}
+bool directory::contains(const string& name){
+   return entries().contains(name_table::find(name));
+}
+inode* directory::get(const string& name){
+   return entries().find(name_table::find(name));
+}
 
+void directory::expand(){
+   // The caller holds the lock.  Readers see the children all at
+   // once, when the filled in table is published.
+   shared_ptr<const snapshot_image> from = move(image);
+   const snapshot_inode& rec = from->inode(record);
+   const uint32_t* children = from->children(rec);
+   const dirent_version& now = *dirents.load(memory_order_relaxed);
+   inode* self = now.find(name_table::dot);
+   dirent_table next;
+   next.assign(name_table::dot, self);
+   next.assign(name_table::dotdot, now.find(name_table::dotdot));
+   for(uint32_t index = 0; index < rec.count; ++index){
+      const snapshot_inode& child = from->inode(children[index]);
+      name_id name = name_table::intern(from->name(child.name));
+      inode_ptr node;
+      if(child.type == snapshot_type::DIRECTORY){
+         node = inode::make(file_type::DIRECTORY_TYPE, child.inode_nr);
+         directory& dir = static_cast<directory&>(*node->contents);
+         dir.start(node.get(), self);
+         dir.totals.store({child.files, child.dirs, child.bytes});
+         dir.entry_count = child.count + 2;
+         dir.image = from;
+         dir.record = children[index];
+         dir.unexpanded = true;
+         dir.history = history;
+         dir.search_index = search_index;
+      }else{
+         node = inode::make(file_type::PLAIN_TYPE, child.inode_nr);
+         plain_file& file = static_cast<plain_file&>(*node->contents);
+         file.data.borrow(from->payload(child), child.length,
+                          child.count);
+         file.image = from;
+      }
+      node->contents->currName = name;
+      node->contents->parent = this;
+      // Filling in is no change, so the history is not told.
+      node->born = self->born;
+      next.assign(name, node.get());
+      node->link = node;
+   }
+   replace_table(make_unique<dirent_version>(move(next)));
+   unexpanded.store(false, memory_order_release);
+   DEBUGF ('p', "inode " << rec.inode_nr << ", " << rec.count
+          << " entries");
+}
+
+bool base_file::contains(const string&){
+   return false;
 }
-inode_ptr base_file::get(const string&){
+inode* base_file::get(const string&){
+   return nullptr;
 }
 void inode_state::ls(const string& str){
-    inode_ptr temp = cwd;
-    if (str.compare(".") ==0){
-      cout <<getDir()<< ":" <<endl ;
-      cwd->contents->ls();
-    }else if (str.compare("..") == 0){
-      cwd = cwd->contents->get("..");
-      cout <<getDir()<< ":" <<endl ;
-      cwd->contents->ls(); 
-    }else{
-       inode_ptr p = root->contents->find(str);
-       if(p == nullptr){ 
-          cout << str << " Does not exit" << endl;
-          return;
-       }  
-       cwd = p;
-       cout <<getDir()<< ":" <<endl ;
-       cwd->contents->ls();
+    rcu_reader section;
+    settle();
+    inode* p = resolve(str);
+    if(p == nullptr){
+       output() << str << " Does not exit" << '\n';
+       return;
     }
-    cwd = temp;
+    if(p->this_type != file_type::DIRECTORY_TYPE){
+       output() << column (p->get_inode_nr(), 8)
+                << column (p->contents->size(), 8)
+                << "  " << str << '\n';
+       return;
+    }
+    static_cast<directory&>(*p->contents).printDir(output());
+    p->contents->ls();
+}
+void inode_state::du(const string& str){
+    rcu_reader section;
+    settle();
+    inode* p = resolve(str);
+    if(p == nullptr){
+       output() << str << " Does not exit" << '\n';
+       return;
+    }
+    subtree_totals t = p->contents->usage();
+    if(p->this_type == file_type::DIRECTORY_TYPE)
+       --t.dirs;
+    output() << column (t.files, 8) << column (t.dirs, 8)
+             << column (t.bytes, 12) << "  "
+             << (p->this_type == file_type::DIRECTORY_TYPE
+                 ? p->contents->path() : str) << '\n';
 }
 void inode_state::lsr(const string& str){
-    inode_ptr curr;
-    curr = root;
-    curr->contents->lsr(cwd->contents->getName());     
-}
-void directory::lsr(const string& end){
-   if(end.length() >0 )
-      printDir();
-   vector<base_file_ptr> v;
-   auto itor = dirents.begin();
-    while(itor != dirents.end() ){ 
-       cout << setw(8)<< dirents[itor->first]->get_inode_nr()
-            << setw(8)<< dirents[itor->first]->contents->size() 
-            << "  " << itor->first;
-       if(dirents[itor->first]->this_type == file_type::DIRECTORY_TYPE
-          && itor->first.compare("..") != 0
-          && itor->first.compare(".") != 0){
-          cout<< "/"<<endl;
-          v.push_back(dirents[itor->first]->contents);
-       }
-       else
-          cout<< endl;
-      ++itor;  
+    rcu_reader section;
+    settle();
+    inode* p = resolve(str);
+    if(p == nullptr || p->this_type != file_type::DIRECTORY_TYPE){
+       output() << str << " Does not exit" << '\n';
+       return;
     }
-    if(currName.compare(end) ==0)
-       return; 
-    while (!v.empty()){ 
-      v.back()->lsr(end);
+    p->contents->lsr();
+}
+// lsr_part -
+//    One piece of the output of a parallel lsr:  its own text,
+//    followed by the text of the parts after it, in order.
+
+struct lsr_part {
+   output_sink text;
+   vector<unique_ptr<lsr_part>> next;
+};
+
+void directory::lsr(){
+   if(totals.files + totals.dirs < lsr_parallel_min){
+      lsr_serial(output());
+      return;
+   }
+   work_pool& pool = work_pool::shared();
+   work_group group;
+   lsr_part whole;
+   lsr_task(whole, pool, group);
+   pool.wait(group);
+   vector<const lsr_part*> v {&whole};
+   while(!v.empty()){
+      const lsr_part* part = v.back();
       v.pop_back();
-    }    
-}
-void directory::printDir(){
-  int count = 0;
-   string dir;
-   inode_ptr temp = dirents["."];
-   while(temp->contents->getName().compare("/") !=0 ){
-    count ++;
-     dir = "/" + temp->contents->getName() + dir;
-     temp = temp->contents->get("..");
-     if (count >20)
-        break;
-   }
-   if(count == 0)
-      cout << "/";
-   cout << dir <<":" <<endl; ;
+      output() << part->text.text();
+      for(auto itor = part->next.rbegin(); itor != part->next.rend();
+          ++itor)
+         v.push_back(itor->get());
+   }
+}
+void directory::lsr_serial(output_sink& out){
+   // Preorder walk with an explicit stack so that deep trees cannot
+   // overflow the call stack.  Children are pushed in reverse so
+   // that they are listed in lexicographic order.
+   vector<directory*> v {this};
+   while(!v.empty()){
+      directory& d = *v.back();
+      v.pop_back();
+      const dirent_version& table = d.entries();
+      d.printDir(out);
+      d.list(out, table);
+      size_t first = v.size();
+      for(const auto& entry: table){
+         if(entry.second->this_type == file_type::DIRECTORY_TYPE
+            && entry.first != name_table::dotdot
+            && entry.first != name_table::dot)
+            v.push_back(
+               static_cast<directory*>(entry.second->contents));
+      }
+      reverse(v.begin() + first, v.end());
+   }
+}
+void directory::lsr_task(lsr_part& part, work_pool& pool,
+                         work_group& group){
+   // This directory is listed, and its subdirectories noted, from
+   // one version of its table.  Small subtrees are listed here, after
+   // whatever part precedes them.  The tasks need no read-side
+   // section of their own:  the command's lasts until they are done.
+   vector<directory*> children;
+   const dirent_version& table = entries();
+   printDir(part.text);
+   list(part.text, table);
+   for(const auto& entry: table){
+      if(entry.second->this_type == file_type::DIRECTORY_TYPE
+         && entry.first != name_table::dotdot
+         && entry.first != name_table::dot)
+         children.push_back(
+            static_cast<directory*>(entry.second->contents));
+   }
+   output_sink* here = &part.text;
+   for(directory* child_dir: children){
+      directory& child = *child_dir;
+      if(child.totals.files + child.totals.dirs < lsr_task_min){
+         if(here == nullptr){
+            part.next.push_back(make_unique<lsr_part>());
+            here = &part.next.back()->text;
+         }
+         child.lsr_serial(*here);
+         continue;
+      }
+      part.next.push_back(make_unique<lsr_part>());
+      lsr_part& child_part = *part.next.back();
+      pool.submit([&child, &child_part, &pool, &group] {
+         child.lsr_task(child_part, pool, group);
+      }, group);
+      here = nullptr;
+   }
+}
+// grep_file, grep_part -
+//    A file to search, with what names it, and a run of files that
+//    one task searches into a buffer of its own.
+
+struct grep_file {
+   const directory* dir;  // nullptr for a file named on its own
+   name_id name;
+   const inode* node;
+};
+
+struct grep_part {
+   size_t begin;
+   size_t end;
+   output_sink text;
+};
+
+void inode_state::grep(const string& pattern, const string& str,
+                       grep_mode mode){
+   rcu_reader section;
+   settle();
+   inode* p = resolve(str);
+   if(p == nullptr){
+      output() << "grep: " << str << ": No such file or directory\n";
+      return;
+   }
+   // The files, in the order lsr would list them.
+   vector<grep_file> files;
+   size_t total = 0;
+   if(p->this_type != file_type::DIRECTORY_TYPE){
+      files.push_back({nullptr, name_table::empty, p});
+      total = p->contents->size();
+   }
+   vector<directory*> v;
+   if(p->this_type == file_type::DIRECTORY_TYPE)
+      v.push_back(static_cast<directory*>(p->contents));
+   while(!v.empty()){
+      directory& d = *v.back();
+      v.pop_back();
+      size_t first = v.size();
+      for(const auto& entry: d.entries()){
+         if(entry.first == name_table::dot
+            || entry.first == name_table::dotdot)
+            continue;
+         if(entry.second->this_type == file_type::DIRECTORY_TYPE){
+            v.push_back(
+               static_cast<directory*>(entry.second->contents));
+         }else {
+            files.push_back({&d, entry.first, entry.second});
+            total += entry.second->contents->size();
+         }
+      }
+      reverse(v.begin() + first, v.end());
+   }
+
+   auto search = [&files, &pattern, &str, mode](size_t begin,
+                                                size_t end,
+                                                output_sink& out){
+      for(size_t i = begin; i < end; ++i){
+         const grep_file& each = files[i];
+         string_view text = each.node->contents->readfile().text();
+         size_t at = find_text(text, pattern);
+         if(at == string_view::npos)
+            continue;
+         size_t count = 1;
+         if(mode == grep_mode::COUNT){
+            while((at = find_text(text, pattern,
+                                  at + max<size_t>(pattern.size(), 1)))
+                  != string_view::npos)
+               ++count;
+            out << column (count, 8) << "  ";
+         }
+         if(each.dir == nullptr){
+            out << str;
+         }else {
+            const string& dir = each.dir->path();
+            out << dir << (dir == "/" ? "" : "/")
+                << name_table::name(each.name);
+         }
+         if(mode == grep_mode::TEXT)
+            out << ": " << text;
+         out << '\n';
+      }
+   };
+
+   // Runs of about the same size, a few for each thread.
+   work_pool& pool = work_pool::shared();
+   size_t target = max(total / (pool.size() * 4), grep_task_min);
+   vector<unique_ptr<grep_part>> parts;
+   size_t bytes = 0;
+   for(size_t i = 0; i < files.size(); ++i){
+      if(parts.empty() || bytes >= target){
+         parts.push_back(make_unique<grep_part>());
+         parts.back()->begin = i;
+         bytes = 0;
+      }
+      parts.back()->end = i + 1;
+      bytes += files[i].node->contents->size();
+   }
+   if(parts.size() <= 1){
+      search(0, files.size(), output());
+      return;
+   }
+   work_group group;
+   for(auto& part: parts){
+      grep_part* run = part.get();
+      pool.submit([&search, run]{
+         search(run->begin, run->end, run->text);
+      }, group);
+   }
+   pool.wait(group);
+   for(const auto& part: parts)
+      output() << part->text.text();
+}
+void directory::printDir(output_sink& out){
+   out << path() << ":" << '\n';
+}
+const string& directory::path() const {
+   unsigned gen = path_generation.load(memory_order_acquire);
+   const cached_path* cached = path_cache.load(memory_order_acquire);
+   if(cached != nullptr && cached->generation == gen)
+      return cached->text;
+   // Climb to the nearest directory whose cached path is current,
+   // then rebuild the stale paths on the way back down.
+   static mutex path_lock;
+   lock_guard<mutex> guard(path_lock);
+   auto current = [gen](const directory* d){
+      const cached_path* c = d->path_cache.load(memory_order_relaxed);
+      return c != nullptr && c->generation == gen;
+   };
+   vector<const directory*> chain;
+   const directory* d = this;
+   while(!current(d) && d->parent != nullptr){
+      chain.push_back(d);
+      d = d->parent;
+   }
+   if(!current(d))
+      d->set_path(gen, "/");
+   while(!chain.empty()){
+      const directory* c = chain.back();
+      chain.pop_back();
+      const string& up = c->parent->path_cache.load()->text;
+      string text;
+      if(up.compare("/") != 0)
+         text = up;
+      text += "/";
+      text += name_table::name(c->currName);
+      c->set_path(gen, move(text));
+   }
+   return path_cache.load(memory_order_acquire)->text;
+}
+void directory::set_path(unsigned generation, string text) const {
+   const cached_path* old = path_cache.exchange(
+                            new cached_path {generation, move(text)},
+                            memory_order_acq_rel);
+   if(old != nullptr)
+      rcu::retire([old] { delete old; });
+}
+const string& base_file::path() const {
+   throw file_error ("is a " + error_file_type());
 }
 void directory::ls(){
-    auto itor = dirents.begin();
-    while(itor != dirents.end() ){ 
-       cout << setw(8)<< dirents[itor->first]->get_inode_nr()
-            << setw(8)<< dirents[itor->first]->contents->size() 
-            << "  " << itor->first;
-       if(dirents[itor->first]->this_type == file_type::DIRECTORY_TYPE
-          && itor->first.compare("..") != 0
-          && itor->first.compare(".") != 0)
-          cout<< "/"<<endl;
+    list(output(), entries());
+}
+void directory::list(output_sink& out, const dirent_version& table){
+    auto itor = table.begin();
+    while(itor != table.end() ){ 
+       out << column (itor->second->get_inode_nr(), 8)
+           << column (itor->second->contents->size(), 8)
+           << "  " << name_table::name(itor->first);
+       if(itor->second->this_type == file_type::DIRECTORY_TYPE
+          && itor->first != name_table::dotdot
+          && itor->first != name_table::dot)
+          out << "/" << '\n';
        else
-          cout<< endl;
+          out << '\n';
       ++itor;  
     }
 }
 void base_file::ls(){
 }
 void inode_state::readfile(const string& str){
-   cwd->contents->readfile(str);
-}
-const void directory::readfile(const string& name){
-   if(!contains(name)){
-      cout << "cat: " <<name << ": No such file or directory" << endl;
+   rcu_reader section;
+   settle();
+   inode* p = resolve(str);
+   if(p == nullptr){
+      output() << "cat: " << str << ": No such file or directory\n";
       return;
    }
-   wordvec output = dirents[name]->contents->readfile();
-   auto i = output.rbegin();
-   while(i != output.rend()){
-      cout << *i << " ";
-      ++i;
-   }
-   cout << endl;
-}
-const void base_file::readfile(const string&){
-}
-inode_ptr directory::find(const string& str){ // call on root
-   if(str.compare("/") ==0)
-     return dirents[".."];
-   if(contains(str))   
-     return dirents[str];
-   else{
-     auto itor = dirents.begin();
-     ++itor;
-     ++itor; 
-     while(itor != dirents.end()){
-        if(dirents[itor->first]->this_type == file_type::DIRECTORY_TYPE)
-           return dirents[itor->first]->contents->find(str);
-      ++itor;
-     }
-      return nullptr;
-    }
-      
+   if(p->this_type == file_type::DIRECTORY_TYPE){
+      output() << "cat: " << str << ": Is a directory" << '\n';
+      return;
+   }
+   string_view text = p->contents->readfile().text();
+   output() << text;
+   if(text.size() > 0)
+      output() << " ";
+   output() << '\n';
 }
-inode_ptr base_file::find(const string&){
+void base_file::lsr(){
 }
-void base_file::lsr(const string&){
+
+// unlink -
+//    Does the work of rm.  A directory is left alone unless any_type
+//    is set, and then false is returned.
+
+bool inode_state::unlink(const string& s, bool any_type){
+   string name;
+   inode* parent = resolve_parent(s, name);
+   inode* node = nullptr;
+   if(parent != nullptr
+      && parent->this_type == file_type::DIRECTORY_TYPE
+      && name.compare(".") != 0 && name.compare("..") != 0){
+      directory& dir = static_cast<directory&>(*parent->contents);
+      auto dir_guard = dir.writing();
+      node = dir.entries().find(name_table::find(name));
+      if(node != nullptr){
+         if(!any_type && node->this_type == file_type::DIRECTORY_TYPE)
+            return false;
+         record(journal_op::RM, {cwd->contents->path(), s});
+         if(node->this_type == file_type::DIRECTORY_TYPE)
+            relocate(node, parent);
+         dir.remove(name);
+         invalidate();
+      }
+   }
+   if(node == nullptr)
+      output() << "rm: cannot remove '"<< s <<
+       "': No such file or directory"<< '\n';
+   return true;
 }
 
 void inode_state::rm(const string& s){
-   if(cwd->contents->contains(s)){
-      cwd->contents->remove(s);   
+   // A plain file is removed under the shared lock, like make.  A
+   // directory may hold the cwd of other sessions, so it is removed
+   // with the tree held alone.
+   rcu_reader section;
+   {
+      shared_lock<shared_mutex> guard(tree_->lock);
+      settle();
+      if(unlink(s, false))
+         return;
    }
-   else
-      cout << "rm: cannot remove '"<< s <<
-       "': No such file or directory"<< endl; 
+   unique_lock<shared_mutex> guard(tree_->lock);
+   settle();
+   unlink(s, true);
 }
 
 void inode_state::rmr(const string& s){
-   inode_ptr temp = root->contents->find(s);
-   inode_ptr temp2 = temp->contents->get("..");
-   temp->contents->rmr();
-   temp2->contents->remove(s);   
+   rcu_reader section;
+   unique_lock<shared_mutex> guard(tree_->lock);
+   settle();
+   string name;
+   inode* parent = resolve_parent(s, name);
+   if(parent == nullptr
+      || parent->this_type != file_type::DIRECTORY_TYPE
+      || name.compare(".") == 0 || name.compare("..") == 0
+      || !parent->contents->contains(name)){
+      output() << "rmr: cannot remove '"<< s <<
+       "': No such file or directory"<< '\n';
+      return;
+   }
+   record(journal_op::RMR, {cwd->contents->path(), s});
+   directory& dir = static_cast<directory&>(*parent->contents);
+   auto dir_guard = dir.writing();
+   inode* temp = dir.entries().find(name_table::find(name));
+   // Any session inside the subtree is moved up out of it.  The
+   // subtree itself goes to the reclaimer.
+   if(temp->this_type == file_type::DIRECTORY_TYPE)
+      relocate(temp, parent);
+   dir.remove(name);
+   invalidate();
+}
+
+void inode_state::snapshot(const string& name){
+   rcu_reader section;
+   unique_lock<shared_mutex> guard(tree_->lock);
+   settle();
+   if(!tree_->history.take(name, tree_->root.load())){
+      output() << "snapshot: " << name << ": already exists" << '\n';
+      return;
+   }
+   record(journal_op::SNAPSHOT, {name});
+}
+
+void inode_state::rollback(const string& name){
+   rcu_reader section;
+   unique_lock<shared_mutex> guard(tree_->lock);
+   settle();
+   unsigned since = 0;
+   inode* top = tree_->history.rollback(name, since);
+   if(top == nullptr){
+      output() << "rollback: " << name << ": no such snapshot" << '\n';
+      return;
+   }
+   inode* now = tree_->root.load();
+   if(now != top){
+      // A tree loaded since is let go, and the one before comes back.
+      ++directory::path_generation;
+      tree_->root.store(top, memory_order_release);
+      directory::release(move(now->link));
+   }
+   relocate_where([since](const inode* where){
+      return where->born >= since;
+   }, top);
+   invalidate();
+   if(tree_->index.enabled())
+      reindex();
+   record(journal_op::ROLLBACK, {name});
 }
 
-void directory::rmr(){
-   auto i = dirents.begin();
-   ++i;
-   ++i;
-   while(i != dirents.end()){
-      if(dirents[i->first]->this_type == file_type::DIRECTORY_TYPE)
-         dirents[i->first]->contents->rmr();
-     ++i;  
+void inode_state::drop_snapshot(const string& name){
+   rcu_reader section;
+   unique_lock<shared_mutex> guard(tree_->lock);
+   settle();
+   if(!tree_->history.drop(name)){
+      output() << "snapshot: " << name << ": no such snapshot" << '\n';
+      return;
    }
-      dirents.clear();
+   record(journal_op::DROP, {name});
 }
-void base_file::rmr(){
+
+void inode_state::snapshots(){
+   tree_->history.list(output());
+}
+
+void inode_state::save(const string& filename){
+   // Breadth first, so that each directory's children get adjacent
+   // records and its child list can be written as soon as it is seen.
+   rcu_reader section;
+   unique_lock<shared_mutex> guard(tree_->lock);
+   settle();
+   snapshot_writer out;
+   vector<inode*> nodes {tree_->root.load()};
+   const directory& top =
+      static_cast<directory&>(*nodes.front()->contents);
+   out.inode(out.add_inode()).name = out.name(top.currName);
+   for(size_t index = 0; index < nodes.size(); ++index){
+      inode* node = nodes[index];
+      snapshot_inode& rec = out.inode(index);
+      rec.inode_nr = node->get_inode_nr();
+      if(node->this_type == file_type::PLAIN_TYPE){
+         const file_content& data = node->contents->readfile();
+         rec.type = snapshot_type::PLAIN;
+         rec.offset = out.payload().size();
+         rec.length = data.size();
+         rec.count = data.word_count();
+         data.append_image(out.payload());
+         continue;
+      }
+      directory& dir = static_cast<directory&>(*node->contents);
+      rec.type = snapshot_type::DIRECTORY;
+      rec.offset = out.child_count();
+      rec.files = dir.totals.files;
+      rec.dirs = dir.totals.dirs;
+      rec.bytes = dir.totals.bytes;
+      for(const auto& entry: dir.entries()){
+         if(entry.first == name_table::dot
+            || entry.first == name_table::dotdot)
+            continue;
+         uint32_t child = out.add_inode();
+         out.inode(child).name = out.name(entry.first);
+         out.add_child(child);
+         nodes.push_back(entry.second);
+      }
+      out.inode(index).count = out.child_count()
+                               - out.inode(index).offset;
+   }
+   out.write(filename, tree_->history.peek_inode_nr());
+   if(tree_->log != nullptr){
+      // The snapshot holds no prompt, so the journal carries it on.
+      tree_->log->checkpoint(filesystem::absolute(filename).string());
+      record(journal_op::PROMPT, {prompt_});
+   }
+}
+
+void inode_state::load(const string& filename){
+   rcu_reader section;
+   unique_lock<shared_mutex> guard(tree_->lock);
+   settle();
+   auto from = make_shared<const snapshot_image>(filename);
+   const snapshot_inode& top = from->inode(0);
+   if(top.type != snapshot_type::DIRECTORY)
+      throw snapshot_error(filename + ": root is not a directory");
+   inode_ptr fresh = inode::make(file_type::DIRECTORY_TYPE,
+                                 top.inode_nr);
+   directory& dir = static_cast<directory&>(*fresh->contents);
+   dir.start(fresh.get(), nullptr);
+   dir.currName = name_table::intern(from->name(top.name));
+   dir.totals.store({top.files, top.dirs, top.bytes});
+   dir.entry_count = top.count + 2;
+   dir.image = from;
+   dir.record = 0;
+   dir.unexpanded = true;
+   dir.history = &tree_->history;
+   dir.search_index = &tree_->index;
+   fresh->link = fresh;
+   tree_->history.set_inode_nr(from->next_inode_nr());
+   ++directory::path_generation;
+   invalidate();
+   relocate(nullptr, fresh.get());
+   inode* old = tree_->root.exchange(fresh.get());
+   if(!tree_->history.keep(old->link))
+      reclaimer::shared().retire(move(old->link));
+   if(tree_->index.enabled())
+      reindex();
+   record(journal_op::LOAD, {filesystem::absolute(filename).string()});
+}
+
+void inode_state::replay(journal_op op, wordspan args){
+   // Each change is made from the directory it was first made from.
+   if(op == journal_op::PROMPT && args.size() == 1){
+      prompt_ = args[0];
+      return;
+   }
+   if(op == journal_op::LOAD && args.size() == 1){
+      load(string(args[0]));
+      return;
+   }
+   if(op == journal_op::SNAPSHOT && args.size() == 1){
+      snapshot(string(args[0]));
+      return;
+   }
+   if(op == journal_op::ROLLBACK && args.size() == 1){
+      rollback(string(args[0]));
+      return;
+   }
+   if(op == journal_op::DROP && args.size() == 1){
+      drop_snapshot(string(args[0]));
+      return;
+   }
+   // The cwd goes back to the root however the change ends.
+   struct cwd_restore {
+      inode_state& state;
+      inode_ptr top;
+      ~cwd_restore(){ state.set_cwd(move(top)); }
+   } restore {*this, tree_->root.load()->link};
+   inode* dir = nullptr;
+   if(args.size() >= 2){
+      rcu_reader section;
+      shared_lock<shared_mutex> guard(tree_->lock);
+      settle();
+      dir = resolve(string(args[0]));
+      if(dir != nullptr && dir->this_type == file_type::DIRECTORY_TYPE)
+         set_cwd(dir->link);
+   }
+   if(dir == nullptr || dir->this_type != file_type::DIRECTORY_TYPE)
+      throw journal_error("bad journal record");
+   string name {args[1]};
+   switch(op){
+      case journal_op::MAKE:  mkfile(name, args.subspan(2)); break;
+      case journal_op::MKDIR: mkdir(name); break;
+      case journal_op::RM:    rm(name); break;
+      case journal_op::RMR:   rmr(name); break;
+      case journal_op::IMPORT:
+         if(args.size() != 3)
+            throw journal_error("bad journal record");
+         add_host(name, read_host(string(args[2])), string(args[2]));
+         break;
+      default:
+         throw journal_error("bad journal record");
+   }
 }
@@ -3,45 +3,197 @@
 #ifndef __INODE_H__
 #define __INODE_H__
 
+#include <atomic>
 #include <exception>
+#include <functional>
 #include <iostream>
 #include <memory>
-#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 using namespace std;
 
+#include "content.h"
+#include "dirents.h"
+#include "journal.h"
+#include "names.h"
 #include "util.h"
 
 // inode_t -
 //    An inode is either a directory or a plain file.
 
 enum class file_type {PLAIN_TYPE, DIRECTORY_TYPE};
+enum class grep_mode {TEXT, COUNT, NAMES};
 class inode;
 class base_file;
+struct lsr_part;
+class work_group;
+class work_pool;
+class snapshot_image;
+class tree_history;
 class plain_file;
 class directory;
+class word_index;
 using inode_ptr = shared_ptr<inode>;
-using base_file_ptr = shared_ptr<base_file>;
+using base_file_ptr = base_file*;
 ostream& operator<< (ostream&, file_type);
 
 
+// dentry_key -
+//    Key of the path lookup cache:  the inode number of the directory
+//    a lookup started from, and the path as it was typed.
+
+using dentry_key = pair<int,string>;
+
+struct dentry_hash {
+   size_t operator() (const dentry_key& key) const {
+      return hash<string>() (key.second) * 31 + key.first;
+   }
+};
+
 // inode_state -
 //    A small convenient class to maintain the state of the simulated
 //    process:  the root (/), the current directory (.), and the
-//    prompt.
+//    prompt.  The tree itself, with its root and journal, is shared:
+//    a state made from the tree of another is a new session on the
+//    same tree, with its own cwd, prompt, and lookup cache.
+//    Sessions may run commands at once on different threads.  Every
+//    command runs inside an rcu read-side section.  ls, lsr, cat, du,
+//    and pwd take no lock at all, and read each directory's current
+//    table as it is published.  cd, mkdir, and make hold the tree lock
+//    shared, and make their change with the directory's own lock, so
+//    writers wait only for others in the same directory.  rm of a
+//    directory, rmr, save, and load hold the tree lock alone, since
+//    they move the cwd of other sessions or see the whole tree.
+//    A removal that takes away the cwd of another session posts it a
+//    move, which the session takes at the start of its next command.
+//    Until then it may go on reading where it was, and what was
+//    removed is not freed until it is done.
+// rmr -
+//    Unlinks a subtree and hands it to the reclaimer, which destroys
+//    it in the background.  The cost to the shell does not depend on
+//    the size of the subtree.
+// snapshot, rollback, drop_snapshot, snapshots -
+//    Name the tree as it is now, put it back as it was when named,
+//    forget a name, and list the names, through the tree's history.
+//    Each holds the tree lock alone, and a snapshot takes constant
+//    time.  A rollback moves any session whose cwd was made since to
+//    the root.  Snapshots live only in memory:  save writes the tree
+//    as it is, so a journal replayed from a checkpoint knows only the
+//    snapshots taken since.
+// save -
+//    Writes the whole tree to a snapshot file.
+// load -
+//    Replaces the tree with the one in a snapshot file.  The file is
+//    mapped, and only the root is built.  Each directory is filled
+//    in from the image the first time its entries are needed, and
+//    plain files read their text from the mapping in place, so
+//    loading takes the same time whatever the size of the tree.
+//    Inode numbers are those of the tree that was saved.
+// attach -
+//    Starts logging every change to the tree, and to the prompt, in
+//    a journal.  Each change is logged with the path of the
+//    directory it was made from, so it can be replayed without
+//    knowing the cwd of the time.  Each change is logged while its
+//    directory is still locked, so the journal holds changes in the
+//    order they were made.  save checkpoints the journal.  A change
+//    the journal can no longer log is still made, with a complaint.
+// replay -
+//    Makes one change read back from a journal.
+// resolve -
+//    Walks a path one component at a time, starting at the root if
+//    the path is absolute and at the cwd otherwise.  Returns nullptr
+//    if some component does not exist or is not a directory.  The
+//    inode returned is good until the caller's read-side section
+//    ends.  Results are remembered in a bounded cache which is
+//    dropped whenever an entry is removed or replaced, by this
+//    session or any other, before what it held can be freed.
+// grep -
+//    Prints each plain file at or below a path whose text holds a
+//    pattern:  its path and text, the text as cat prints it; or for
+//    COUNT, how many times the pattern occurs and the path; or for
+//    NAMES, only the path.  Files are reported in the order lsr
+//    reaches them.  The files of a large subtree are split into runs
+//    of about the same number of bytes, which the threads of the
+//    shared work_pool search at once, each into a buffer of its own,
+//    and the buffers are written out in order.
+// glob -
+//    Expands the wildcards in a path into every path in the tree
+//    that matches, in the order ls would list them.  Each component
+//    with wildcards is compiled once, and in each directory only the
+//    names that begin with its literal prefix are looked at.  A path
+//    with no wildcards, or one that matches nothing, is returned as
+//    it is, as the shell does, so the command can complain about it.
+// index, index_usage, search -
+//    Turn the tree's word index on or off, print what it holds, and
+//    print the path of each plain file whose text has a word in it,
+//    in the order the files were made.  Turning the index on reads
+//    in the whole tree, and so does load while it is on.  Searching
+//    takes time in the number of files found, not the size of the
+//    tree.  Each holds the tree lock shared, except that turning the
+//    index on or off holds it alone.
+// import_host, export_host -
+//    Copy a host file into the tree, or a plain file of the tree out
+//    to the host, or with recursive, a directory and everything below
+//    it.  A path that names a directory gets the file inside it, under
+//    its own name.  A host file is mapped, and its text split at any
+//    white space straight into the new file's storage, before any
+//    lock is taken; only linking the file in holds the tree lock
+//    shared and the directory's lock.  Each file exported is written
+//    from its text in place, with one write, and no lock is taken.
+//    An import is journaled by the host path, like load, so it is
+//    replayed from the host file as it is then.
+// read_host, add_host, make_dir -
+//    Make a file from a host file, not yet linked into the tree; link
+//    it in at a path; and make a directory at a path unless there is
+//    one, returning whether there is one now.
 
 class inode_state {
    friend class inode;
    friend ostream& operator<< (ostream& out, const inode_state&);
+   public:
+      struct shared_tree;
+      using tree_ptr = shared_ptr<shared_tree>;
    private:
-      inode_ptr root {nullptr};
+      static constexpr size_t dentry_limit {1 << 16};
+      static constexpr size_t grep_task_min {1 << 16};  // bytes
+      tree_ptr tree_;
+      // Written only by this session's own thread, holding cwd_lock,
+      // which others take to read it.
       inode_ptr cwd {nullptr};
+      mutex cwd_lock;
+      inode_ptr moved_to {nullptr};  // posted under cwd_lock
+      atomic<bool> moved {false};
       string prompt_ {"% "};
+      unordered_map<dentry_key,inode*,dentry_hash> dentries;
+      unsigned dentry_gen {0};
+      void join();
+      void settle();
+      void set_cwd (inode_ptr dir);
+      void relocate (const inode* gone, inode* to);
+      void relocate_where (function<bool (const inode*)> gone,
+                           inode* to);
+      void invalidate();
+      void reindex();
+      void record (journal_op op, initializer_list<string_view> args,
+                   wordspan words = {});
+      directory& cwd_dir();
+      inode* resolve_parent (const string& path, string& name);
+      bool unlink (const string& path, bool any_type);
+      inode_ptr read_host (const string& host);
+      void add_host (const string& path, inode_ptr file,
+                     const string& host);
+      bool make_dir (const string& path);
+      static bool is_ancestor (const inode* dir, const inode* node);
    public:
       inode_state (const inode_state&) = delete; // copy ctor
       inode_state& operator= (const inode_state&) = delete; // op=
       inode_state();
+      explicit inode_state (tree_ptr shared);
       ~inode_state();
+      tree_ptr tree() const {return tree_;}
       const string& prompt() const;
       virtual string getName();
       string getDir();
@@ -49,24 +201,58 @@ class inode_state {
       void cd(const string& str);
       void readfile(const string& str);
       void ls(const string& str);
-      void mkfile(const wordvec& words);
-      void changePrompt(const string& str){prompt_ = str;}
+      void mkfile(const string& name, wordspan words);
+      void changePrompt(const string& str);
       void lsr(const string& str);
+      void grep(const string& pattern, const string& str,
+                grep_mode mode);
       void rm(const string& s);
       void rmr(const string& s);
+      void du(const string& str);
+      void snapshot(const string& name);
+      void rollback(const string& name);
+      void drop_snapshot(const string& name);
+      void snapshots();
+      void save(const string& filename);
+      void load(const string& filename);
+      void attach(journal* journal_);
+      void replay(journal_op op, wordspan args);
+      inode* resolve (const string& path);
+      vector<string> glob (const string& path);
+      void index(bool on);
+      void index_usage();
+      void search(const string& word);
+      void import_host(const string& host, const string& path,
+                       bool recursive);
+      void export_host(const string& path, const string& host,
+                       bool recursive);
 };
 
 // class inode -
-// inode ctor -
-//    Create a new inode of the given type.
+// make -
+//    Create a new inode of the given type and number.  The inode, its
+//    contents, and the shared_ptr control block are allocated
+//    together in one slab slot, which goes back to the slab when the
+//    inode dies.  Inodes loaded from a snapshot are given their saved
+//    numbers.
 // get_inode_nr -
 //    Retrieves the serial number of the inode.  Inode numbers are
-//    allocated in sequence by small integer.
+//    allocated in sequence by small integer, from an atomic counter
+//    in the tree's history, so that sessions may make files at once.
 // size -
 //    Returns the size of an inode.  For a directory, this is the
 //    number of dirents.  For a text file, the number of characters
 //    when printed (the sum of the lengths of each word, plus the
 //    number of words.
+// link -
+//    The inode's reference to itself, held while it is linked into
+//    the tree.  Directory entries are plain pointers, so this is what
+//    keeps an inode alive in the tree.  Unlinking hands the link to
+//    rcu::retire, or for a directory to the reclaimer, so the inode
+//    lives on until no reader can still reach it.  While a snapshot
+//    needs it, the tree's history holds it instead.
+// born -
+//    The epoch of the tree_history clock when the inode was made.
 //    
 
 class inode {
@@ -74,12 +260,17 @@ class inode {
    friend class base_file;
    friend class plain_file;
    friend class directory;
+   friend class reclaimer;
+   friend class tree_history;
    private:
-      static int next_inode_nr;
       int inode_nr;
+      unsigned born;
       base_file_ptr contents;
+      inode_ptr link;
+   protected:
+      inode (file_type, base_file_ptr payload, int number);
    public:
-      inode (file_type);
+      static inode_ptr make (file_type, int number);
       ~inode();
       int get_inode_nr() const;
       void cd(const string&);
@@ -87,11 +278,45 @@ class inode {
 
 };
 
-
+
+// subtree_totals -
+//    What lives below a directory:  the number of plain files, the
+//    number of directories (not counting the directory itself), and
+//    the total size of the plain files.
+
+struct subtree_totals {
+   size_t files {0};
+   size_t dirs {0};
+   size_t bytes {0};
+};
+
+// subtree_counts -
+//    The totals as a directory keeps them.  Writers in any directory
+//    below it change them without holding its lock, so each count is
+//    atomic.  A reader may see a change to one count before another.
+
+struct subtree_counts {
+   atomic<size_t> files {0};
+   atomic<size_t> dirs {0};
+   atomic<size_t> bytes {0};
+   subtree_totals load() const {return {files, dirs, bytes};}
+   void store (const subtree_totals& totals) {
+      files = totals.files;
+      dirs = totals.dirs;
+      bytes = totals.bytes;
+   }
+};
+
 // class base_file -
 // Just a base class at which an inode can point.  No data or
 // functions.  Makes the synthesized members useable only from
 // the derived classes.
+// usage -
+//    What this file adds to the totals of every directory above it.
+// image, record -
+//    The snapshot a file was loaded from and its index there.  A
+//    directory fills itself in from the record and then lets go;
+//    a plain file holds on while it borrows its text from the image.
 
 class file_error: public runtime_error {
    public:
@@ -100,105 +325,202 @@ class file_error: public runtime_error {
 
 class base_file {
    friend class inode;
+   friend class directory;
    protected:
       base_file() = default;
       virtual const string& error_file_type() const = 0;
-      string currName;
+      name_id currName {name_table::empty};
+      directory* parent {nullptr};
+      shared_ptr<const snapshot_image> image;
+      uint32_t record {0};
    public:
       virtual ~base_file() = default;
       base_file (const base_file&) = delete;
       base_file& operator= (const base_file&) = delete;
       virtual size_t size() const = 0;
-      virtual const wordvec& readfile() const;
-      virtual void writefile (const wordvec& newdata);
+      virtual const file_content& readfile() const;
+      virtual void writefile (wordspan newdata);
       virtual void remove (const string& filename);
       virtual inode_ptr mkdir (const string& dirname);
-      virtual inode_ptr mkfile (const string& filename);
+      virtual inode_ptr mkfile (const string& filename,
+                                wordspan words);
       virtual void add_entry(const string& key, inode_ptr value) =0;
       virtual void changeName(const string name);
-      virtual string getName(){return currName;}
+      virtual string getName(){return name_table::name(currName);}
+      virtual const string& path() const;
+      virtual subtree_totals usage() const = 0;
+      directory* get_parent() const {return parent;}
       virtual bool contains(const string& str);
-      virtual inode_ptr get(const string& str);
+      virtual inode* get(const string& str);
       virtual void ls();
-      virtual void lsr(const string& end);
-      virtual const void readfile(const string& name);
-      virtual inode_ptr find(const string&);
-      virtual void rmr();
+      virtual void lsr();
 };
 
 // class plain_file -
 // Used to hold data.
 // synthesized default ctor -
-//    Default vector<string> is a an empty vector.
+//    Default file_content is an empty file.
+// size -
+//    The length of the text, kept by file_content, so it costs
+//    nothing to look up on every ls.
 // readfile -
-//    Returns a copy of the contents of the wordvec in the file.
+//    Returns the contents of the file.
 // writefile -
 //    Replaces the contents of a file with new contents.
 
 class plain_file: public base_file {
    friend class inode_state;
+   friend class directory;
    private:
-      wordvec data;
+      file_content data;
       virtual const string& error_file_type() const override {
          static const string result = "plain file";
          return result;
       }
    public:
       virtual size_t size() const override;
-      virtual const wordvec& readfile() const override;
-      virtual void writefile (const wordvec& newdata) override;
+      virtual subtree_totals usage() const override;
+      virtual const file_content& readfile() const override;
+      virtual void writefile (wordspan newdata) override;
       virtual void add_entry(const string& key, inode_ptr value);
       virtual void changeName(const string name) override;
-      virtual string getName(){return currName;}
+      virtual string getName(){return name_table::name(currName);}
 };
 
 // class directory -
 // Used to map filenames onto inode pointers.
 // default ctor -
 //    Creates a new map with keys "." and "..".
+// entries, writing -
+//    The entries are published as a dirent_version, which is never
+//    changed.  entries returns the current one, after filling it in
+//    from the snapshot the first time, and takes no lock otherwise.
+//    It stays good until the caller's read-side section ends.  A
+//    writer holds writing, makes the next version, and publishes it
+//    with one atomic store, retiring the old one to rcu.  remove,
+//    mkdir, mkfile, and add_entry expect the caller to hold writing.
+// start -
+//    Gives a new directory its first table:  dot (.) and dotdot (..),
+//    the parent, which for / is / itself.
+// size -
+//    The number of entries, kept in an atomic count so that listing
+//    a parent need not look at each child's table.
 // remove -
 //    Removes the file or subdirectory from the current inode.
 //    Throws an file_error if this is not a directory, the file
 //    does not exist, or the subdirectory is not empty.
 //    Here empty means the only entries are dot (.) and dotdot (..).
+//    The removed entry no longer counts toward the totals, and its
+//    link is retired.
 // mkdir -
 //    Creates a new directory under the current directory and 
 //    immediately adds the directories dot (.) and dotdot (..) to it.
-//    Note that the parent (..) of / is / itself.  It is an error
-//    if the entry already exists.
+//    It is an error if the entry already exists.
 // mkfile -
-//    Create a new empty text file with the given name.  Error if
-//    a dirent with that name exists.
+//    Create a new text file with the given name and contents,
+//    replacing any file of that name.
+// add_file -
+//    Links a plain file already filled in under a name, replacing any
+//    file of that name.
+// path -
+//    Returns the absolute pathname of this directory.  Each directory
+//    keeps a link to its parent and caches its own path, built from
+//    the parent's cached path.  Renaming a directory, and replacing
+//    the whole tree by load or rollback, bumps a generation count, so
+//    stale paths are rebuilt lazily.  Removing a directory does not,
+//    since it changes the path of no directory left in the tree.
+//    Rebuilding is serialized by a lock, and each path is published
+//    like a table, so the string returned stays good until the
+//    caller's read-side section ends.
+// subtree -
+//    Returns the totals for everything below this directory.  They
+//    are kept current by add_usage and sub_usage, which adjust this
+//    directory and every directory above it.
+// history, preserved -
+//    The history of the tree the directory is in, which publish,
+//    add_usage, and sub_usage tell before anything changes, and the
+//    epoch at which the directory was last kept there.  mkdir and
+//    mkfile number new inodes from it.
+// search_index, unindex -
+//    The word index of the tree the directory is in.  mkfile adds
+//    the new file to it, and let_go takes every file at or below what
+//    it lets go out of it, before the link is let go.
+// replace_table -
+//    Publishes a table without telling the history, to fill in a
+//    directory or to put back a kept one.
+// release -
+//    Lets go of the link of an inode no longer in the tree.
+// lsr -
+//    Lists this directory and everything below it, in preorder.
+//    Large trees are split among the threads of the shared work_pool.
+//    Each task renders its subtrees into its own buffer, and the
+//    buffers are written out in the order of the serial walk, so the
+//    output is the same either way.
 
 class directory: public base_file {
    friend class inode_state;
+   friend class reclaimer;
+   friend class tree_history;
    private:
-      // Must be a map, not unordered_map, so printing is lexicographic
-      //string currName;
-      map<string,inode_ptr> dirents;
+      struct cached_path {
+         unsigned generation;
+         string text;
+      };
+      static atomic<unsigned> path_generation;
+      static constexpr size_t lsr_parallel_min {1 << 12};
+      static constexpr size_t lsr_task_min {1 << 8};
+      // Iterates in lexicographic order, so printing is sorted.
+      atomic<const dirent_version*> dirents {nullptr};
+      subtree_counts totals;
+      atomic<size_t> entry_count {0};
+      // Set while the entries are still only in the snapshot.
+      atomic<bool> unexpanded {false};
+      tree_history* history {nullptr};
+      atomic<unsigned> preserved {0};
+      word_index* search_index {nullptr};
+      mutable mutex lock;
+      mutable atomic<const cached_path*> path_cache {nullptr};
       virtual const string& error_file_type() const override {
       static const string result = "directory";
       return result;
       
       }
+      void publish (unique_ptr<dirent_version> next);
+      void replace_table (unique_ptr<dirent_version> next);
+      void start (inode* self, inode* up);
+      void let_go (inode* node);
+      void unindex (inode* node);
+      static void release (inode_ptr link);
+      void expand();
+      void set_path (unsigned generation, string text) const;
+      void list (output_sink& out, const dirent_version& table);
+      void lsr_serial (output_sink& out);
+      void lsr_task (lsr_part& part, work_pool& pool,
+                     work_group& group);
    public:
       virtual ~directory();
       virtual size_t size() const override;
+      virtual subtree_totals usage() const override;
+      subtree_totals subtree() const {return totals.load();}
+      const dirent_version& entries();
+      unique_lock<mutex> writing();
+      void add_usage(const subtree_totals& delta);
+      void sub_usage(const subtree_totals& delta);
       virtual void remove (const string& filename) override;
       virtual inode_ptr mkdir (const string& dirname) override;
-      virtual inode_ptr mkfile (const string& filename) override;
+      virtual inode_ptr mkfile (const string& filename,
+                                wordspan words) override;
+      void add_file (const string& filename, inode_ptr file);
       virtual void add_entry(const string& key,
                              inode_ptr value) override;
       virtual void changeName(const string name) override;
-      virtual string getName(){return currName;}
+      virtual string getName(){return name_table::name(currName);}
       bool contains(const string& str);
-      inode_ptr get(const string& str);
+      inode* get(const string& str);
       virtual void ls();
-      virtual void lsr(const string& end);
-      virtual const void readfile(const string& name);
-      virtual inode_ptr find(const string& str);
-      void printDir();
-      virtual void rmr();
+      virtual void lsr();
+      virtual const string& path() const override;
+      void printDir(output_sink& out);
 };
 
 #endif
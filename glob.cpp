@@ -0,0 +1,128 @@
+// $Id: glob.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include "glob.h"
+
+glob_pattern::glob_pattern (string_view pattern) {
+   for (size_t at = 0; at < pattern.size(); ++at) {
+      char chr = pattern[at];
+      if (chr == '*') {
+         // A run of stars matches what one does.
+         if (tokens.empty() or tokens.back().what != kind::STAR) {
+            tokens.push_back ({kind::STAR, {}, {}});
+         }
+         continue;
+      }
+      if (chr == '?') {
+         tokens.push_back ({kind::ANY, {}, {}});
+         continue;
+      }
+      if (chr == '[') {
+         size_t end = parse_set (pattern, at);
+         if (end != string_view::npos) {
+            at = end;
+            continue;
+         }
+      }else if (chr == '\\' and at + 1 < pattern.size()) {
+         chr = pattern[++at];
+      }
+      if (tokens.empty() or tokens.back().what != kind::LITERAL) {
+         tokens.push_back ({kind::LITERAL, {}, {}});
+      }
+      tokens.back().text += chr;
+   }
+   if (not tokens.empty() and tokens.front().what == kind::LITERAL) {
+      prefix_ = tokens.front().text;
+   }
+   hidden = not prefix_.empty() and prefix_[0] == '.';
+}
+
+// parse_set -
+//    Adds the set that begins at a [ and returns where its ] is, or
+//    npos if there is none.  A ] right after the [, or after the !,
+//    is in the set, as is any character after a backslash.
+
+size_t glob_pattern::parse_set (string_view pattern, size_t at) {
+   size_t pos = at + 1;
+   bool negated = pos < pattern.size()
+                  and (pattern[pos] == '!' or pattern[pos] == '^');
+   if (negated) ++pos;
+   bitset<UCHAR_MAX + 1> set;
+   for (size_t first = pos; pos < pattern.size(); ++pos) {
+      unsigned char low = pattern[pos];
+      if (low == ']' and pos > first) {
+         tokens.push_back ({kind::SET, {}, negated ? ~set : set});
+         return pos;
+      }
+      if (low == '\\' and pos + 1 < pattern.size()) {
+         low = pattern[++pos];
+      }
+      if (pos + 2 < pattern.size() and pattern[pos + 1] == '-'
+          and pattern[pos + 2] != ']') {
+         unsigned char high = pattern[pos + 2];
+         for (unsigned chr = low; chr <= high; ++chr) set.set (chr);
+         pos += 2;
+      }else {
+         set.set (low);
+      }
+   }
+   return string_view::npos;
+}
+
+bool glob_pattern::is_pattern (string_view text) {
+   return text.find_first_of ("*?[") != string_view::npos;
+}
+
+// matches -
+//    Every token but a star matches a fixed number of characters, so
+//    when one fails it is enough to let the last star before it take
+//    one more character and go on from there.
+
+bool glob_pattern::matches (string_view name) const {
+   if (name == "." or name == "..") return false;
+   if (not name.empty() and name[0] == '.' and not hidden) return false;
+   size_t tok = 0;
+   size_t at = 0;
+   size_t star = string_view::npos;
+   size_t star_at = 0;
+   for (;;) {
+      if (tok < tokens.size()) {
+         const token& each = tokens[tok];
+         switch (each.what) {
+            case kind::STAR:
+               star = tok++;
+               star_at = at;
+               continue;
+            case kind::ANY:
+               if (at < name.size()) {
+                  ++tok;
+                  ++at;
+                  continue;
+               }
+               break;
+            case kind::SET:
+               if (at < name.size() and each.set.test (
+                   static_cast<unsigned char> (name[at]))) {
+                  ++tok;
+                  ++at;
+                  continue;
+               }
+               break;
+            case kind::LITERAL:
+               if (name.substr (at).substr (0, each.text.size())
+                   == each.text) {
+                  ++tok;
+                  at += each.text.size();
+                  continue;
+               }
+               break;
+         }
+      }else if (at == name.size()) {
+         return true;
+      }
+      if (star == string_view::npos or star_at == name.size()) {
+         return false;
+      }
+      tok = star + 1;
+      at = ++star_at;
+   }
+}
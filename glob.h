@@ -0,0 +1,51 @@
+// $Id: glob.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// glob_pattern -
+//    One component of a path with wildcards, compiled once so that
+//    it can be matched against every name in a directory.  As in the
+//    shell, * matches any run of characters, ? any one character,
+//    and [...] any one of a set, with ranges like a-z, and ! or ^
+//    first to match any character not in it.  A backslash makes the
+//    character after it literal, and so does a [ with no closing ].
+//    A name that begins with a dot is matched only by a pattern that
+//    does too, and dot and dotdot are never matched.
+// is_pattern -
+//    Whether some character of the text is a wildcard.
+// prefix -
+//    The literal text every matching name begins with.  Directories
+//    are kept in order by name, so only the range of names beginning
+//    with it need be looked at.
+// matches -
+//    Whether a name matches the whole pattern.
+
+#ifndef __GLOB_H__
+#define __GLOB_H__
+
+#include <bitset>
+#include <climits>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+class glob_pattern {
+   private:
+      enum class kind {LITERAL, ANY, STAR, SET};
+      struct token {
+         kind what;
+         string text;                 // LITERAL
+         bitset<UCHAR_MAX + 1> set;   // SET
+      };
+      vector<token> tokens;
+      string prefix_;
+      bool hidden;
+      size_t parse_set (string_view pattern, size_t at);
+   public:
+      explicit glob_pattern (string_view pattern);
+      static bool is_pattern (string_view text);
+      const string& prefix() const { return prefix_; }
+      bool matches (string_view name) const;
+};
+
+#endif
+
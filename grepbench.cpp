@@ -0,0 +1,109 @@
+// $Id: grepbench.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// grepbench -
+//    Measures how fast grep searches file contents.  A tree of dirs
+//    directories with files files each is built, every file holding
+//    words words of text, about 6 bytes each, drawn from a small
+//    vocabulary.  Each pattern is then searched for, with grep -l so
+//    that output costs little, and also by a loop that calls
+//    string_view::find on each file in turn on one thread, for
+//    comparison.  Prints CSV:  pattern, megabytes searched, files
+//    matched, and gigabytes per second for grep and for the loop.
+//    Arguments:  dirs (64), files (64), words (4096).
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "commands.h"
+#include "file_sys.h"
+#include "util.h"
+
+using bench_clock = chrono::steady_clock;
+
+void build_tree (inode_state& state, int dirs, int files, int words) {
+   static const char* vocabulary[] {
+      "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+      "error", "warning", "status", "value", "table", "entry",
+      "request", "response",
+   };
+   mt19937 random (1);
+   wordvec content;
+   for (int dir = 0; dir < dirs; ++dir) {
+      string name = "d" + to_string (dir);
+      state.mkdir (name);
+      state.cd (name);
+      for (int file = 0; file < files; ++file) {
+         content.clear();
+         for (int word = 0; word < words; ++word) {
+            content.push_back (vocabulary[random() % 16]);
+         }
+         // One file in eight holds a rare word somewhere.
+         if (random() % 8 == 0) {
+            content[random() % words] = "needle";
+         }
+         viewvec views (content.begin(), content.end());
+         state.mkfile ("f" + to_string (file), views);
+      }
+      state.cd ("/");
+   }
+}
+
+int main (int argc, char** argv) {
+   int dirs = argc > 1 ? stoi (argv[1]) : 64;
+   int files = argc > 2 ? stoi (argv[2]) : 64;
+   int words = argc > 3 ? stoi (argv[3]) : 4096;
+   inode_state state;
+   build_tree (state, dirs, files, words);
+
+   // The text of every file, for the loop to search.
+   vector<string> texts;
+   for (int dir = 0; dir < dirs; ++dir) {
+      for (int file = 0; file < files; ++file) {
+         output_sink out;
+         ostringstream errors;
+         output_scope scope (out, errors);
+         execute (state, viewvec {"cat", "/d" + to_string (dir)
+                                  + "/f" + to_string (file)});
+         texts.emplace_back (out.text());
+      }
+   }
+   size_t bytes = 0;
+   for (const auto& text: texts) bytes += text.size();
+
+   cout << "pattern,megabytes,matched,grep_gbps,find_gbps" << endl;
+   for (const char* pattern: {"needle", "respond", "status value"}) {
+      output_sink out;
+      ostringstream errors;
+      size_t matched = 0;
+      auto start = bench_clock::now();
+      {
+         output_scope scope (out, errors);
+         execute (state, viewvec {"grep", "-l", pattern, "/"});
+      }
+      chrono::duration<double> grep_time = bench_clock::now() - start;
+      for (char chr: out.text()) matched += chr == '\n';
+
+      start = bench_clock::now();
+      size_t found = 0;
+      for (const auto& text: texts) {
+         found += string_view (text).find (pattern) != string::npos;
+      }
+      chrono::duration<double> find_time = bench_clock::now() - start;
+      if (found != matched) {
+         cerr << pattern << ": grep matched " << matched
+              << " files, find " << found << endl;
+      }
+      cout << pattern << "," << bytes / 1e6 << "," << matched << ","
+           << bytes / 1e9 / grep_time.count() << ","
+           << bytes / 1e9 / find_time.count() << endl;
+   }
+   return EXIT_SUCCESS;
+}
+
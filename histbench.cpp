@@ -0,0 +1,170 @@
+// $Id: histbench.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// histbench -
+//    Checks that a snapshot costs memory in proportion to what has
+//    changed since, not to the size of the tree.  Every operator new
+//    is counted, so the bytes live on the heap are known at any time.
+//    Inodes come from the slabs, which take their chunks with aligned
+//    new and are not counted; kept inodes are counted by snapshots.
+//    For trees of growing size, the same files are replaced twice,
+//    picked by the same random sequence:  once with no snapshot, and
+//    once after taking one.  The files are picked from the same first
+//    directories in every tree, so only the tree grows, not the work.
+//    What the changes gain with a snapshot, less what the same
+//    changes gained without one, is what the snapshot keeps.  The
+//    tree is then rolled back and listed, and the listing compared
+//    with the one taken with the snapshot.  Prints CSV:  files in the
+//    tree, changes, heap bytes taken by the snapshot itself, heap
+//    bytes gained by the changes without and with a snapshot, the
+//    bytes kept and the same per change, inodes kept, and whether the
+//    rollback put the tree back.  Exits with failure if any rollback
+//    did not, if the changes without a snapshot freed memory, which
+//    would make them no baseline, or if the bytes kept in the largest
+//    tree are more than twice those in the smallest.
+
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <malloc.h>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+#include "file_sys.h"
+#include "rcu.h"
+#include "reclaim.h"
+#include "util.h"
+
+static atomic<long long> live_bytes {0};
+
+void* operator new (size_t size) {
+   void* block = malloc (size == 0 ? 1 : size);
+   if (block == nullptr) throw bad_alloc();
+   live_bytes += malloc_usable_size (block);
+   return block;
+}
+
+void operator delete (void* block) noexcept {
+   if (block == nullptr) return;
+   live_bytes -= malloc_usable_size (block);
+   free (block);
+}
+
+void operator delete (void* block, size_t) noexcept {
+   operator delete (block);
+}
+
+// settled_bytes -
+//    The heap in use once everything retired has been freed.
+
+long long settled_bytes() {
+   promise<void> done;
+   rcu::retire ([&done] { done.set_value(); });
+   done.get_future().wait();
+   reclaimer::shared().wait();
+   return live_bytes;
+}
+
+void build_tree (inode_state& state, int dirs, int files) {
+   wordvec content {"alpha", "beta", "gamma"};
+   viewvec views (content.begin(), content.end());
+   for (int dir = 0; dir < dirs; ++dir) {
+      string name = "d" + to_string (dir);
+      state.mkdir (name);
+      state.cd (name);
+      for (int file = 0; file < files; ++file) {
+         state.mkfile ("f" + to_string (file), views);
+      }
+      state.cd ("/");
+   }
+}
+
+void change_files (inode_state& state, int dirs, int files,
+                   int changes, mt19937& random) {
+   wordvec content {"changed", "text"};
+   viewvec views (content.begin(), content.end());
+   for (int change = 0; change < changes; ++change) {
+      state.cd ("/d" + to_string (random() % dirs));
+      state.mkfile ("f" + to_string (random() % files), views);
+   }
+   state.cd ("/");
+}
+
+// captured -
+//    What a function prints.
+
+template <typename fn_t>
+string captured (fn_t fn) {
+   output_sink out;
+   ostringstream errors;
+   {
+      output_scope scope (out, errors);
+      fn();
+   }
+   return string (out.text());
+}
+
+int main (int argc, char** argv) {
+   int changes = argc > 1 ? stoi (argv[1]) : 1000;
+   int files = 100;
+   int changed_dirs = 100;
+   bool failed = false;
+   long long first_kept = 0;
+   cout << "files,changes,snapshot_bytes,plain_bytes,changed_bytes,"
+        << "kept_bytes,kept_per_change,kept_inodes,restored" << endl;
+   for (int dirs: {100, 1000, 4000}) {
+      inode_state state;
+      build_tree (state, dirs, files);
+      // Replacing a file drops the lookups cached while the tree was
+      // built, which would be counted against the first changes.
+      mt19937 random (dirs);
+      change_files (state, changed_dirs, files, 1, random);
+      random.seed (dirs);
+      long long before = settled_bytes();
+      change_files (state, changed_dirs, files, changes, random);
+      long long plain = settled_bytes() - before;
+
+      string listing = captured ([&state] { state.lsr ("/"); });
+      before = settled_bytes();
+      state.snapshot ("bench");
+      long long taken = settled_bytes();
+      random.seed (dirs);
+      change_files (state, changed_dirs, files, changes, random);
+      long long changed = settled_bytes() - taken;
+      long long kept = changed - plain;
+      istringstream list (captured ([&state] { state.snapshots(); }));
+      size_t kept_dirs = 0;
+      size_t kept_inodes = 0;
+      list >> kept_dirs >> kept_inodes;
+
+      state.rollback ("bench");
+      bool restored = captured ([&state] { state.lsr ("/"); })
+                      == listing;
+      cout << dirs * files << "," << changes << "," << taken - before
+           << "," << plain << "," << changed << "," << kept << ","
+           << kept / changes << "," << kept_inodes << ","
+           << boolalpha << restored << endl;
+      if (not restored) {
+         cerr << "histbench: rollback of " << dirs * files
+              << " files did not restore the tree" << endl;
+         failed = true;
+      }
+      if (plain < 0) {
+         cerr << "histbench: the changes to " << dirs * files
+              << " files freed " << -plain << " bytes" << endl;
+         failed = true;
+      }
+      if (first_kept == 0) {
+         first_kept = kept;
+      }else if (kept > 2 * first_kept) {
+         cerr << "histbench: " << kept << " bytes kept for "
+              << dirs * files << " files, against " << first_kept
+              << " for the smallest tree" << endl;
+         failed = true;
+      }
+   }
+   return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
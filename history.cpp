@@ -0,0 +1,186 @@
+// $Id: history.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <iostream>
+#include <unordered_set>
+
+using namespace std;
+
+#include "debug.h"
+#include "history.h"
+#include "trace.h"
+
+atomic<unsigned> tree_history::clock {1};
+
+tree_history::~tree_history() {
+   for (auto& each: snapshots) let_go (each);
+}
+
+tree_history::snapshot* tree_history::named (const string& name) {
+   for (auto& each: snapshots) {
+      if (each.name == name) return &each;
+   }
+   return nullptr;
+}
+
+// let_go -
+//    Frees what a snapshot kept.  Its tables were never published,
+//    so no reader can hold one.
+
+void tree_history::let_go (snapshot& gone) {
+   gone.dirs.clear();
+   for (auto& link: gone.kept) directory::release (move (link));
+   gone.kept.clear();
+}
+
+void tree_history::save (directory& dir) {
+   lock_guard<mutex> guard (lock);
+   if (snapshots.empty()) return;
+   snapshot& last = snapshots.back();
+   if (dir.preserved.load (memory_order_relaxed) >= last.epoch) return;
+   // The table is immutable, so the copy shares its sealed base and
+   // copies only the changes made since that was built.
+   const dirent_version& now =
+         *dir.dirents.load (memory_order_acquire);
+   inode* self = now.find (name_table::dot);
+   if (self->born < last.epoch) {
+      last.dirs.push_back ({self, make_unique<dirent_version> (now),
+                            dir.totals.load()});
+   }
+   dir.preserved.store (clock, memory_order_release);
+}
+
+bool tree_history::keep (inode_ptr& link) {
+   if (newest.load (memory_order_acquire) == 0) return false;
+   lock_guard<mutex> guard (lock);
+   if (snapshots.empty() or link->born >= snapshots.back().epoch) {
+      return false;
+   }
+   snapshots.back().kept.push_back (move (link));
+   return true;
+}
+
+bool tree_history::take (const string& name, inode* root) {
+   lock_guard<mutex> guard (lock);
+   if (named (name) != nullptr) return false;
+   unsigned epoch = ++clock;
+   snapshots.push_back ({name, epoch, peek_inode_nr(), root, {}, {}});
+   newest.store (epoch, memory_order_release);
+   DEBUGF ('h', name << " at epoch " << epoch);
+   TRACE ('h', "take", epoch);
+   return true;
+}
+
+inode* tree_history::rollback (const string& name, unsigned& since) {
+   lock_guard<mutex> guard (lock);
+   snapshot* target = named (name);
+   if (target == nullptr) return nullptr;
+   size_t first = target - snapshots.data();
+   since = target->epoch;
+   auto made_since = [since] (const inode* node) {
+      return node->born >= since;
+   };
+   auto dir_of = [] (inode* node) -> directory& {
+      return static_cast<directory&> (*node->contents);
+   };
+
+   // Whatever was linked in since is let go.  It can only be in a
+   // directory that has changed, and each is looked at once.
+   unordered_set<directory*> seen;
+   for (size_t index = first; index < snapshots.size(); ++index) {
+      for (const auto& saved: snapshots[index].dirs) {
+         directory& dir = dir_of (saved.self);
+         if (made_since (saved.self)
+             or not seen.insert (&dir).second) continue;
+         for (const auto& entry: *dir.dirents.load()) {
+            if (entry.first != name_table::dot
+                and entry.first != name_table::dotdot
+                and made_since (entry.second)) {
+               directory::release (move (entry.second->link));
+            }
+         }
+      }
+   }
+
+   // Newest first, so that each directory ends as it was kept by
+   // the oldest of them, which is as it was at the snapshot.  Its
+   // mark is cleared, since what kept it is gone, and a snapshot
+   // before may yet need it kept again.
+   for (size_t index = snapshots.size(); index-- > first;) {
+      auto& dirs = snapshots[index].dirs;
+      for (auto saved = dirs.rbegin(); saved != dirs.rend(); ++saved) {
+         if (made_since (saved->self)) continue;
+         directory& dir = dir_of (saved->self);
+         dir.replace_table (move (saved->table));
+         dir.totals.store (saved->totals);
+         dir.preserved.store (0, memory_order_relaxed);
+      }
+   }
+   size_t relinked = 0;
+   for (size_t index = first; index < snapshots.size(); ++index) {
+      for (auto& link: snapshots[index].kept) {
+         if (made_since (link.get())) {
+            directory::release (move (link));
+         }else {
+            inode* node = link.get();
+            node->link = move (link);
+            ++relinked;
+         }
+      }
+   }
+   DEBUGF ('h', name << ": " << seen.size()
+          << " directories put back, " << relinked
+          << " inodes linked again");
+   TRACE ('h', "rollback", seen.size(), relinked);
+
+   inode* root = target->root;
+   set_inode_nr (target->next_inode_nr);
+   snapshots.erase (snapshots.begin() + first + 1, snapshots.end());
+   snapshot& kept = snapshots.back();
+   kept.dirs.clear();
+   kept.kept.clear();
+   kept.epoch = ++clock;
+   newest.store (kept.epoch, memory_order_release);
+   return root;
+}
+
+bool tree_history::drop (const string& name) {
+   lock_guard<mutex> guard (lock);
+   snapshot* gone = named (name);
+   if (gone == nullptr) return false;
+   size_t at = gone - snapshots.data();
+   if (at == 0) {
+      let_go (*gone);
+   }else {
+      // The snapshot before needs what existed when it was taken, and
+      // of each directory only the oldest table kept.
+      snapshot& before = snapshots[at - 1];
+      unordered_set<const inode*> has;
+      for (const auto& saved: before.dirs) has.insert (saved.self);
+      for (auto& saved: gone->dirs) {
+         if (saved.self->born < before.epoch
+             and has.count (saved.self) == 0) {
+            before.dirs.push_back (move (saved));
+         }
+      }
+      for (auto& link: gone->kept) {
+         if (link->born < before.epoch) {
+            before.kept.push_back (move (link));
+         }else {
+            directory::release (move (link));
+         }
+      }
+   }
+   snapshots.erase (snapshots.begin() + at);
+   newest.store (snapshots.empty() ? 0 : snapshots.back().epoch,
+                 memory_order_release);
+   return true;
+}
+
+void tree_history::list (output_sink& out) {
+   lock_guard<mutex> guard (lock);
+   for (const auto& each: snapshots) {
+      out << column (each.dirs.size(), 8)
+          << column (each.kept.size(), 8) << "  " << each.name << '\n';
+   }
+}
+
@@ -0,0 +1,124 @@
+// $Id: history.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// tree_history -
+//    Named snapshots of one tree, to roll back to later.  Taking one
+//    copies nothing.  The tree is kept persistent from then on, by
+//    path copying:  the first time after the newest snapshot that a
+//    directory is about to change, the table it is about to replace,
+//    which is never changed in place, is kept along with its totals.
+//    A change in a directory changes the totals of every directory
+//    above it, so what one change copies is the path from there to
+//    the root, and later changes share what is already copied.  An
+//    inode unlinked while some snapshot still holds it is kept
+//    instead of freed.  Plain files are never changed in place, since
+//    make replaces a file with a new inode, so they need no copy.  A
+//    snapshot thus costs memory in proportion to what has changed
+//    since it was taken, not to the size of the tree.
+// epoch, born -
+//    A clock for the whole process, which moves whenever a snapshot
+//    is taken or rolled back to.  Each snapshot notes the time it was
+//    taken, and each inode the time it was made, so an inode made at
+//    or after a snapshot was not in it.  A directory filled in from a
+//    saved tree counts its children as made when it was.
+// new_inode_nr, peek_inode_nr, set_inode_nr -
+//    The numbers of the inodes of the tree are handed out here, since
+//    every directory can reach its tree's history.  Each snapshot
+//    notes the next number, and rollback puts it back, so a number
+//    handed out since, even by a load, is never in use twice.
+// preserve -
+//    Called by a directory before it changes, holding its lock, and
+//    before its totals change.  Once the directory has been kept
+//    since the newest snapshot, or when there is none, it costs one
+//    atomic load and a compare.
+// keep -
+//    Offered the link of an inode just unlinked.  Takes it, and
+//    returns true, if some snapshot was taken since the inode was
+//    made; otherwise leaves it for the caller to let go.
+// take -
+//    Takes a snapshot of the tree with the given root.
+// rollback -
+//    Puts back every directory kept since the snapshot, and links
+//    again every inode kept since it, and lets go of everything made
+//    since.  Snapshots taken after it are dropped; it is kept, so it
+//    can be rolled back to again.  Returns the root the tree had,
+//    or nullptr if there is no such snapshot, and sets since to the
+//    epoch from which inodes were made after it.  The caller holds
+//    the tree alone, and lets go of the root if it has changed.
+// drop -
+//    Forgets a snapshot.  What it kept that an older snapshot still
+//    needs is handed on to that one, and the rest is let go.
+// list -
+//    Prints each snapshot, oldest first:  the directories and inodes
+//    it keeps, and its name.
+
+#ifndef __HISTORY_H__
+#define __HISTORY_H__
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "file_sys.h"
+#include "util.h"
+
+class tree_history {
+   private:
+      struct saved_dir {
+         // Alive as long as the record is:  it is linked into the
+         // tree, or kept by this snapshot or a later one.
+         inode* self;
+         unique_ptr<dirent_version> table;
+         subtree_totals totals;
+      };
+      struct snapshot {
+         string name;
+         unsigned epoch;
+         int next_inode_nr;
+         inode* root;
+         vector<saved_dir> dirs;
+         vector<inode_ptr> kept;
+      };
+      static atomic<unsigned> clock;
+      atomic<unsigned> newest {0};  // epoch of the newest, or 0
+      atomic<int> next_inode_nr {1};
+      mutex lock;
+      vector<snapshot> snapshots;
+      snapshot* named (const string& name);
+      void let_go (snapshot& gone);
+   public:
+      tree_history() = default;
+      tree_history (const tree_history&) = delete;
+      tree_history& operator= (const tree_history&) = delete;
+      ~tree_history();
+      static unsigned epoch() {
+         return clock.load (memory_order_relaxed);
+      }
+      int new_inode_nr() {
+         return next_inode_nr.fetch_add (1, memory_order_relaxed);
+      }
+      int peek_inode_nr() const {
+         return next_inode_nr.load (memory_order_relaxed);
+      }
+      void set_inode_nr (int next) {
+         next_inode_nr.store (next, memory_order_relaxed);
+      }
+      void preserve (directory& dir) {
+         unsigned since = newest.load (memory_order_acquire);
+         if (since != 0
+             and dir.preserved.load (memory_order_acquire) < since) {
+            save (dir);
+         }
+      }
+      void save (directory& dir);
+      bool keep (inode_ptr& link);
+      bool take (const string& name, inode* root);
+      inode* rollback (const string& name, unsigned& since);
+      bool drop (const string& name);
+      void list (output_sink& out);
+};
+
+#endif
+
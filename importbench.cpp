@@ -0,0 +1,119 @@
+// $Id: importbench.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// importbench -
+//    Measures import and export of one large host file.  A file of
+//    megabytes megabytes of words, about 6 bytes each, separated by
+//    spaces and newlines, is written in a scratch directory and
+//    imported, then the imported file is exported again and compared
+//    with the original, with its white space made single spaces.
+//    Prints CSV:  megabytes, seconds to import, gigabytes per second
+//    imported, seconds to export, gigabytes per second exported, and
+//    the peak resident megabytes after each step, so that a second
+//    copy of the text in memory would show.
+//    Arguments:  megabytes (512), scratch directory (/tmp).
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+#include "commands.h"
+#include "file_sys.h"
+#include "mapfile.h"
+#include "util.h"
+
+using bench_clock = chrono::steady_clock;
+
+// peak_megabytes -
+//    The high water mark of the resident set, from /proc.
+
+double peak_megabytes() {
+   ifstream status ("/proc/self/status");
+   for (string line; getline (status, line);) {
+      if (line.compare (0, 6, "VmHWM:") == 0) {
+         return stod (line.substr (6)) / 1024;
+      }
+   }
+   return 0;
+}
+
+void run (inode_state& state, const viewvec& words) {
+   output_sink out;
+   ostringstream errors;
+   {
+      output_scope scope (out, errors);
+      execute (state, words);
+   }
+   if (not errors.str().empty() or not out.text().empty()) {
+      cerr << errors.str() << out.text();
+   }
+}
+
+int main (int argc, char** argv) {
+   size_t megabytes = argc > 1 ? stoul (argv[1]) : 512;
+   string scratch = argc > 2 ? argv[2] : "/tmp";
+   string host = scratch + "/importbench.in";
+   string back = scratch + "/importbench.out";
+   static const char* vocabulary[] {
+      "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+      "error", "warning", "status", "value", "table", "entry",
+      "request", "response",
+   };
+   {
+      mt19937 random (1);
+      ofstream out (host, ios::binary);
+      string line;
+      size_t bytes = 0;
+      while (bytes < megabytes << 20) {
+         line.clear();
+         for (int word = 0; word < 12; ++word) {
+            line += vocabulary[random() % 16];
+            line += word == 11 ? '\n' : ' ';
+         }
+         out << line;
+         bytes += line.size();
+      }
+   }
+   double before = peak_megabytes();
+
+   inode_state state;
+   auto start = bench_clock::now();
+   run (state, {"import", host, "corpus"});
+   chrono::duration<double> import_time = bench_clock::now() - start;
+   double imported = peak_megabytes();
+
+   start = bench_clock::now();
+   run (state, {"export", "corpus", back});
+   chrono::duration<double> export_time = bench_clock::now() - start;
+   double exported = peak_megabytes();
+
+   {
+      mapped_file original (host);
+      mapped_file copy (back);
+      string_view text = original.view();
+      string_view again = copy.view();
+      bool same = text.size() == again.size();
+      for (size_t at = 0; same and at < text.size(); ++at) {
+         char chr = text[at] == '\n' ? ' ' : text[at];
+         same = chr == (again[at] == '\n' ? ' ' : again[at]);
+      }
+      if (not same) cerr << back << ": differs from " << host << endl;
+   }
+   remove (host.c_str());
+   remove (back.c_str());
+
+   double size = megabytes / 1024.0;
+   cout << "megabytes,import_s,import_gbps,export_s,export_gbps,"
+        << "peak_mb_start,peak_mb_import,peak_mb_export" << endl;
+   cout << megabytes << "," << import_time.count() << ","
+        << size / import_time.count() << "," << export_time.count()
+        << "," << size / export_time.count() << "," << before << ","
+        << imported << "," << exported << endl;
+   return EXIT_SUCCESS;
+}
+
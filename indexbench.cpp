@@ -0,0 +1,151 @@
+// $Id: indexbench.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// indexbench -
+//    Measures search against grep -l for the same word.  A tree of
+//    dirs directories with files files each is built, every file
+//    holding words words drawn from a vocabulary of 4096, so that
+//    some words are in many files and some in few.  The index is
+//    turned on, then each word searched for both ways, and the two
+//    lists of files compared.  Then every third file is removed, or
+//    made again with other words, and each word searched for again.
+//    Prints CSV:  files, milliseconds to turn the index on, bytes
+//    of postings per file, and for the searches before and after the
+//    changes, the mean microseconds per search and per grep -l.
+//    Arguments:  dirs (64), files (256), words (64).
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "commands.h"
+#include "file_sys.h"
+#include "util.h"
+
+using bench_clock = chrono::steady_clock;
+
+constexpr int vocabulary {4096};
+constexpr int probes {64};
+
+void make_file (inode_state& state, mt19937& random, int dir,
+                int file, int words) {
+   wordvec content;
+   for (int word = 0; word < words; ++word) {
+      // Skewed, so low-numbered words are common.
+      int low = random() % vocabulary;
+      content.push_back ("w" + to_string (random() % (low + 1)));
+   }
+   viewvec views (content.begin(), content.end());
+   state.cd ("/d" + to_string (dir));
+   state.mkfile ("f" + to_string (file), views);
+   state.cd ("/");
+}
+
+string run (inode_state& state, const viewvec& words) {
+   output_sink out;
+   ostringstream errors;
+   {
+      output_scope scope (out, errors);
+      execute (state, words);
+   }
+   return string (out.text());
+}
+
+// sorted_lines -
+//    search lists files by inode number and grep as lsr would, so
+//    the two are compared in order by name.
+
+vector<string> sorted_lines (const string& text) {
+   vector<string> lines;
+   istringstream in (text);
+   for (string line; getline (in, line);) lines.push_back (line);
+   sort (lines.begin(), lines.end());
+   return lines;
+}
+
+// probe -
+//    Searches for a spread of words both ways, and returns the mean
+//    microseconds of each.
+
+pair<double,double> probe (inode_state& state) {
+   chrono::duration<double,micro> search_time {0};
+   chrono::duration<double,micro> grep_time {0};
+   for (int probe = 0; probe < probes; ++probe) {
+      string word = "w" + to_string (probe * probe);
+      auto start = bench_clock::now();
+      string found = run (state, {"search", word});
+      search_time += bench_clock::now() - start;
+      start = bench_clock::now();
+      // A word is matched as a whole, with a space either side.
+      string grepped = run (state, {"grep", "-l", " " + word + " ",
+                                    "/"});
+      grep_time += bench_clock::now() - start;
+      string edges = run (state, {"grep", "-l", word, "/"});
+      vector<string> expected;
+      for (const string& path: sorted_lines (edges)) {
+         string text = run (state, {"cat", path});
+         text.pop_back();
+         for (const string& each: split (text, " ")) {
+            if (each == word) {
+               expected.push_back (path);
+               break;
+            }
+         }
+      }
+      if (sorted_lines (found) != expected) {
+         cerr << word << ": search found "
+              << sorted_lines (found).size() << " files, grep "
+              << expected.size() << endl;
+      }
+   }
+   return {search_time.count() / probes, grep_time.count() / probes};
+}
+
+int main (int argc, char** argv) {
+   int dirs = argc > 1 ? stoi (argv[1]) : 64;
+   int files = argc > 2 ? stoi (argv[2]) : 256;
+   int words = argc > 3 ? stoi (argv[3]) : 64;
+   inode_state state;
+   mt19937 random (1);
+   for (int dir = 0; dir < dirs; ++dir) {
+      state.mkdir ("d" + to_string (dir));
+      for (int file = 0; file < files; ++file) {
+         make_file (state, random, dir, file, words);
+      }
+   }
+
+   auto start = bench_clock::now();
+   run (state, {"index", "on"});
+   chrono::duration<double,milli> index_time =
+         bench_clock::now() - start;
+   string usage = run (state, {"index"});
+   size_t bytes = stoul (split (usage, " ")[6]);
+   auto [search_before, grep_before] = probe (state);
+
+   for (int dir = 0; dir < dirs; ++dir) {
+      for (int file = dir % 3; file < files; file += 3) {
+         if (random() % 2 == 0) {
+            state.rm ("/d" + to_string (dir) + "/f"
+                      + to_string (file));
+         }else {
+            make_file (state, random, dir, file, words);
+         }
+      }
+   }
+   auto [search_after, grep_after] = probe (state);
+
+   cout << "files,index_ms,bytes_per_file,search_us,grep_us,"
+        << "search_after_us,grep_after_us" << endl;
+   cout << dirs * files << "," << index_time.count() << ","
+        << double (bytes) / (dirs * files) << "," << search_before
+        << "," << grep_before << "," << search_after << ","
+        << grep_after << endl;
+   return EXIT_SUCCESS;
+}
+
@@ -0,0 +1,376 @@
+// $Id: journal.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "debug.h"
+#include "journal.h"
+#include "mapfile.h"
+#include "trace.h"
+
+// Marks a ready word as the start of unused space at the end of the
+// ring, with the number of words to skip in the low bits.
+static constexpr uint32_t skip_mark {0x80000000u};
+// Marks a ready word whose one ring word points at a record too big
+// for the ring, held by its appender until it is on disk.
+static constexpr uint32_t outside_mark {0x40000000u};
+static constexpr size_t frame_header {2 * sizeof (uint32_t)};
+
+journal_error::journal_error (const string& what):
+               runtime_error (what) {
+}
+
+static uint32_t fnv1a (string_view data) {
+   uint32_t hash = 2166136261u;
+   for (char chr: data) {
+      hash ^= static_cast<unsigned char> (chr);
+      hash *= 16777619u;
+   }
+   return hash;
+}
+
+static size_t varint_size (size_t value) {
+   size_t size = 1;
+   for (; value >= 0x80; value >>= 7) ++size;
+   return size;
+}
+
+static char* put_varint (char* out, size_t value) {
+   for (; value >= 0x80; value >>= 7) {
+      *out++ = static_cast<char> (value | 0x80);
+   }
+   *out++ = static_cast<char> (value);
+   return out;
+}
+
+static bool get_varint (string_view& in, size_t& value) {
+   value = 0;
+   for (int shift = 0; not in.empty() and shift < 64; shift += 7) {
+      unsigned char byte = in.front();
+      in.remove_prefix (1);
+      value |= static_cast<size_t> (byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) return true;
+   }
+   return false;
+}
+
+// encode -
+//    Writes one framed record at out, which must have room for it.
+
+static void encode (char* out, size_t body, journal_op op,
+                    initializer_list<string_view> args,
+                    wordspan words) {
+   char* start = out + frame_header;
+   char* next = start;
+   *next++ = static_cast<char> (op);
+   next = put_varint (next, args.size() + words.size());
+   auto put = [&next] (string_view arg) {
+      next = put_varint (next, arg.size());
+      memcpy (next, arg.data(), arg.size());
+      next += arg.size();
+   };
+   for (string_view arg: args) put (arg);
+   for (string_view word: words) put (word);
+   uint32_t length = body;
+   uint32_t check = fnv1a ({start, body});
+   memcpy (out, &length, sizeof length);
+   memcpy (out + sizeof length, &check, sizeof check);
+}
+
+journal::journal (const string& filename, journal_options options_):
+         path (filename), options (options_) {
+   fd = open (filename.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0666);
+   if (fd < 0) throw journal_error (filename + ": " + strerror (errno));
+   ring_words = 1;
+   while (ring_words * sizeof (uint64_t) < options.ring_bytes) {
+      ring_words *= 2;
+   }
+   ring = make_unique<uint64_t[]> (ring_words);
+   ready = make_unique<atomic<uint32_t>[]> (ring_words);
+   writer = thread (&journal::run, this);
+   DEBUGF ('j', filename << ": interval " << options.interval.count()
+          << " ms, threshold " << options.threshold << " bytes");
+}
+
+journal::~journal() {
+   {
+      lock_guard<mutex> guard (lock);
+      stopping = true;
+   }
+   work.notify_one();
+   writer.join();
+   close (fd);
+}
+
+uint64_t journal::reserve (size_t words) {
+   uint64_t pos = head.load (memory_order_relaxed);
+   for (;;) {
+      size_t offset = pos & (ring_words - 1);
+      // A record never wraps; the space left at the end is skipped.
+      size_t skip = ring_words - offset < words ? ring_words - offset
+                                                : 0;
+      if (pos + skip + words - tail.load (memory_order_acquire)
+          > ring_words) {
+         nudge();
+         this_thread::yield();
+         pos = head.load (memory_order_relaxed);
+         continue;
+      }
+      if (head.compare_exchange_weak (pos, pos + skip + words,
+                                      memory_order_acq_rel,
+                                      memory_order_relaxed)) {
+         if (skip > 0) {
+            ready[offset].store (skip_mark | skip,
+                                 memory_order_release);
+         }
+         return pos + skip;
+      }
+   }
+}
+
+void journal::append (journal_op op,
+                      initializer_list<string_view> args,
+                      wordspan words) {
+   size_t body = 1 + varint_size (args.size() + words.size());
+   for (string_view arg: args) body += varint_size (arg.size())
+                                     + arg.size();
+   for (string_view word: words) body += varint_size (word.size())
+                                       + word.size();
+   size_t frame = frame_header + body;
+   size_t words_needed = (frame + sizeof (uint64_t) - 1)
+                       / sizeof (uint64_t);
+   if (frame >= skip_mark) {
+      throw journal_error ("record of " + to_string (frame)
+                           + " bytes is too large");
+   }
+   check();
+   if (words_needed > ring_words / 2 or frame >= outside_mark) {
+      // Too big for the ring:  a slot in it points at the record, so
+      // the record is written in the order it was reserved, and the
+      // record lives until it is on disk.
+      string outside (frame, '\0');
+      encode (outside.data(), body, op, args, words);
+      const string* where = &outside;
+      size_t offset = reserve (1) & (ring_words - 1);
+      memcpy (&ring[offset], &where, sizeof where);
+      ready[offset].store (outside_mark, memory_order_release);
+      ++records_;
+      sync();
+      return;
+   }
+   uint64_t pos = reserve (words_needed);
+   size_t offset = pos & (ring_words - 1);
+   encode (reinterpret_cast<char*> (&ring[offset]), body, op, args,
+           words);
+   ready[offset].store (frame, memory_order_release);
+   ++records_;
+   uint64_t waiting = head.load (memory_order_relaxed)
+                    - durable.load (memory_order_relaxed);
+   if (options.interval.count() == 0
+       or waiting * sizeof (uint64_t) >= options.threshold) {
+      nudge();
+   }
+}
+
+void journal::nudge() {
+   if (wake.exchange (true)) return;
+   // Taking the lock orders the flag against the writer's check.
+   {
+      lock_guard<mutex> guard (lock);
+   }
+   work.notify_one();
+}
+
+void journal::check() const {
+   int error = failure.load();
+   if (error != 0) {
+      throw journal_error (string ("write: ") + strerror (error));
+   }
+}
+
+void journal::sync() {
+   uint64_t target = head.load (memory_order_acquire);
+   unique_lock<mutex> guard (lock);
+   while (durable.load() < target) {
+      check();
+      wake = true;
+      work.notify_one();
+      done.wait (guard);
+   }
+}
+
+void journal::checkpoint (const string& snapshot) {
+   // The new journal is written whole beside the old one and renamed
+   // over it, so a crash leaves one journal or the other.
+   sync();
+   size_t body = 1 + varint_size (1) + varint_size (snapshot.size())
+               + snapshot.size();
+   string record (frame_header + body, '\0');
+   encode (record.data(), body, journal_op::LOAD, {snapshot}, {});
+   string temp = path + ".tmp";
+   int out = open (temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC
+                                  | O_APPEND, 0666);
+   if (out < 0) throw journal_error (temp + ": " + strerror (errno));
+   bool good = ::write (out, record.data(), record.size())
+               == static_cast<ssize_t> (record.size())
+           and replace_file (temp, path);
+   if (not good) {
+      int error = errno;
+      close (out);
+      unlink (temp.c_str());
+      throw journal_error (path + ": " + strerror (error));
+   }
+   {
+      lock_guard<mutex> guard (file_lock);
+      if (dup2 (out, fd) < 0) failure = errno;
+   }
+   close (out);
+   ++records_;
+}
+
+bool journal::write_file (const char* data, size_t size) {
+   lock_guard<mutex> guard (file_lock);
+   while (size > 0) {
+      ssize_t wrote = ::write (fd, data, size);
+      if (wrote < 0) {
+         if (errno == EINTR) continue;
+         failure = errno;
+         return false;
+      }
+      data += wrote;
+      size -= wrote;
+   }
+   return true;
+}
+
+void journal::commit() {
+   // Only this thread moves the tail, so records are written in the
+   // order they were reserved, stopping at the first one that is
+   // still being written.  A record outside the ring is written where
+   // it is, after the batch gathered before it.  Once a write fails,
+   // records are taken off the ring unwritten, and a record outside
+   // it is not touched, since its appender may have given up on it.
+   static thread_local string batch;
+   size_t written = 0;
+   bool good = failure.load() == 0;
+   uint64_t pos = tail.load (memory_order_relaxed);
+   uint64_t end = head.load (memory_order_acquire);
+   while (pos < end) {
+      size_t offset = pos & (ring_words - 1);
+      uint32_t mark = ready[offset].load (memory_order_acquire);
+      if (mark == 0) break;
+      ready[offset].store (0, memory_order_relaxed);
+      if (mark & skip_mark) {
+         pos += mark & ~skip_mark;
+         continue;
+      }
+      if (mark == outside_mark) {
+         const string* outside = nullptr;
+         memcpy (&outside, &ring[offset], sizeof outside);
+         good = good and write_file (batch.data(), batch.size())
+                     and write_file (outside->data(), outside->size());
+         if (good) written += batch.size() + outside->size();
+         batch.clear();
+         ++pos;
+         continue;
+      }
+      if (good) {
+         batch.append (reinterpret_cast<const char*> (&ring[offset]),
+                       mark);
+      }
+      pos += (mark + sizeof (uint64_t) - 1) / sizeof (uint64_t);
+   }
+   tail.store (pos, memory_order_release);
+   if (good and (written > 0 or not batch.empty())) {
+      written += batch.size();
+      good = write_file (batch.data(), batch.size());
+      if (good and fdatasync (fd) < 0) {
+         failure = errno;
+         good = false;
+      }
+      if (good) {
+         ++commits_;
+         DEBUGF ('j', written << " bytes committed");
+         TRACE ('j', "commit", written);
+      }
+   }
+   batch.clear();
+   {
+      lock_guard<mutex> guard (lock);
+      if (good) durable = pos;
+   }
+   done.notify_all();
+}
+
+void journal::run() {
+   for (;;) {
+      bool last = false;
+      {
+         unique_lock<mutex> guard (lock);
+         auto woken = [this] { return wake.load() or stopping; };
+         if (options.interval.count() > 0) {
+            work.wait_for (guard, options.interval, woken);
+         }else {
+            work.wait (guard, woken);
+         }
+         wake = false;
+         last = stopping;
+      }
+      commit();
+      if (last and tail.load() == head.load()) return;
+   }
+}
+
+size_t journal::replay (const string& filename, apply_fn apply) {
+   struct stat status;
+   if (stat (filename.c_str(), &status) < 0 and errno == ENOENT) {
+      return 0;
+   }
+   mapped_file file (filename);
+   string_view text = file.view();
+   size_t count = 0;
+   viewvec args;
+   while (text.size() >= frame_header) {
+      uint32_t length;
+      uint32_t check;
+      memcpy (&length, text.data(), sizeof length);
+      memcpy (&check, text.data() + sizeof length, sizeof check);
+      if (length > text.size() - frame_header) break;
+      string_view body = text.substr (frame_header, length);
+      if (fnv1a (body) != check or body.empty()) break;
+      journal_op op = static_cast<journal_op> (body.front());
+      body.remove_prefix (1);
+      size_t argc = 0;
+      bool good = get_varint (body, argc);
+      args.clear();
+      for (size_t arg = 0; good and arg < argc; ++arg) {
+         size_t size = 0;
+         good = get_varint (body, size) and size <= body.size();
+         if (good) {
+            args.push_back (body.substr (0, size));
+            body.remove_prefix (size);
+         }
+      }
+      if (not good) break;
+      apply (op, args);
+      ++count;
+      text.remove_prefix (frame_header + length);
+   }
+   if (not text.empty()) {
+      size_t good = file.size() - text.size();
+      cerr << exec::execname() << ": " << filename << ": dropped "
+           << text.size() << " bytes of torn journal" << endl;
+      if (truncate (filename.c_str(), good) < 0) {
+         throw journal_error (filename + ": " + strerror (errno));
+      }
+   }
+   DEBUGF ('j', filename << ": " << count << " records replayed");
+   return count;
+}
+
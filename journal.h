@@ -0,0 +1,117 @@
+// $Id: journal.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// journal -
+//    Write-ahead log of the changes made to the tree, so that they
+//    survive the death of the process.  Each record is framed as
+//       uint32_t length   of the body
+//       uint32_t check    FNV-1a of the body
+//       body:             op byte, argument count, and each argument
+//                         as a varint length and its bytes
+//    Records are appended to a ring buffer in memory without taking
+//    a lock:  a command reserves space with one compare-and-swap,
+//    copies its record in, and marks it ready.  A writer thread
+//    drains the ring in order and writes each batch with one write
+//    and one fdatasync, when the commit interval ends or when the
+//    threshold of bytes waiting is reached, whichever is first.  An
+//    interval of zero commits as soon as anything is ready.
+//    Once a write or fdatasync fails, nothing more is written, since
+//    a record written after a lost one would be replayed without it.
+// append -
+//    Queues one record.  Blocks only if the ring is full, or if the
+//    record is too big for it:  then the ring holds a pointer to the
+//    record in its place, and append waits until it is on disk.
+//    Throws journal_error once the journal has failed.
+// sync -
+//    Waits until every record appended so far is on disk, or throws
+//    journal_error if the journal fails first.
+// checkpoint -
+//    Called after the tree has been saved to a snapshot.  The journal
+//    is replaced by one that holds just a record that loads that
+//    snapshot, so the journal alone still rebuilds the tree.
+// replay -
+//    Reads a journal and hands each record to a function.  Reading
+//    stops at the first torn or damaged record, which is cut off
+//    the file so that appending can carry on after it.  Returns the
+//    number of records replayed.
+
+#ifndef __JOURNAL_H__
+#define __JOURNAL_H__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+using namespace std;
+
+#include "util.h"
+
+enum class journal_op: uint8_t {MAKE = 1, MKDIR, RM, RMR, PROMPT, LOAD,
+                                SNAPSHOT, ROLLBACK, DROP, IMPORT};
+
+class journal_error: public runtime_error {
+   public:
+      explicit journal_error (const string& what);
+};
+
+struct journal_options {
+   chrono::milliseconds interval {10};
+   size_t threshold {1 << 16};
+   size_t ring_bytes {1 << 20};
+};
+
+class journal {
+   public:
+      using apply_fn = function<void (journal_op, wordspan)>;
+   private:
+      int fd;
+      string path;
+      journal_options options;
+      size_t ring_words;
+      unique_ptr<uint64_t[]> ring;
+      // For the word where each record starts:  its frame length in
+      // bytes once it is ready, a skip over the end of the ring, or a
+      // mark for a record outside it.
+      unique_ptr<atomic<uint32_t>[]> ready;
+      atomic<uint64_t> head {0};
+      atomic<uint64_t> tail {0};
+      atomic<uint64_t> durable {0};
+      atomic<bool> wake {false};
+      atomic<size_t> records_ {0};
+      atomic<size_t> commits_ {0};
+      atomic<int> failure {0};  // errno of the failed write, or 0
+      bool stopping {false};
+      mutex lock;
+      mutex file_lock;
+      condition_variable work;
+      condition_variable done;
+      thread writer;
+      uint64_t reserve (size_t words);
+      void nudge();
+      void commit();
+      bool write_file (const char* data, size_t size);
+      void check() const;
+      void run();
+   public:
+      journal (const string& filename, journal_options options);
+      journal (const journal&) = delete;
+      journal& operator= (const journal&) = delete;
+      ~journal();
+      void append (journal_op op, initializer_list<string_view> args,
+                   wordspan words = {});
+      void sync();
+      void checkpoint (const string& snapshot);
+      size_t records() const { return records_; }
+      size_t commits() const { return commits_; }
+      static size_t replay (const string& filename, apply_fn apply);
+};
+
+#endif
+
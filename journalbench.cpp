@@ -0,0 +1,61 @@
+// $Id: journalbench.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// journalbench -
+//    Measures journal throughput at several commit intervals.  Each
+//    run appends the same number of make records, as the shell would
+//    log them, and then waits for them to reach the disk.  Prints CSV:
+//    the interval, the threshold, the number of records, the cost of
+//    an append to the caller, the total time including the last sync,
+//    records per second, and the number of commits (fdatasync calls).
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+#include "journal.h"
+#include "util.h"
+
+using bench_clock = chrono::steady_clock;
+
+int main (int argc, char** argv) {
+   size_t count = argc > 1 ? stoul (argv[1]) : 200000;
+   string filename = argc > 2 ? argv[2] : "/tmp/journalbench.log";
+   const long intervals[] {0, 1, 10, 100};
+   const size_t thresholds[] {1 << 16, 1 << 20};
+   string_view words[] {"alpha", "beta", "gamma", "delta"};
+   cout << "interval_ms,threshold,records,append_ns,total_ms,"
+        << "records_per_s,commits" << endl;
+   for (size_t threshold: thresholds) {
+      for (long interval: intervals) {
+         unlink (filename.c_str());
+         journal_options options;
+         options.interval = chrono::milliseconds (interval);
+         options.threshold = threshold;
+         journal log (filename, options);
+         string name;
+         auto start = bench_clock::now();
+         for (size_t record = 0; record < count; ++record) {
+            name = "file" + to_string (record);
+            log.append (journal_op::MAKE, {"/bench/dir", name},
+                        wordspan (words, 4));
+         }
+         auto appended = bench_clock::now();
+         log.sync();
+         auto synced = bench_clock::now();
+         chrono::duration<double,nano> append_ns = appended - start;
+         chrono::duration<double,milli> total_ms = synced - start;
+         cout << interval << "," << threshold << "," << count << ","
+              << append_ns.count() / count << ","
+              << total_ms.count() << ","
+              << static_cast<size_t> (count / total_ms.count() * 1000)
+              << "," << log.commits() << endl;
+      }
+   }
+   unlink (filename.c_str());
+   return EXIT_SUCCESS;
+}
+
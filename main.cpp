@@ -1,8 +1,11 @@
 // $Id: main.cpp,v 1.10 2019-10-08 13:55:31-07 - - $
 
+#include <algorithm>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <utility>
 #include <unistd.h>
 
@@ -11,20 +14,70 @@ using namespace std;
 #include "commands.h"
 #include "debug.h"
 #include "file_sys.h"
+#include "journal.h"
+#include "mapfile.h"
+#include "server.h"
+#include "stats.h"
 #include "util.h"
 
 // scan_options
-//    Options analysis:  The only option is -Dflags. 
+//    Options analysis:  -@flags sets debug flags, -f script reads
+//    commands from a script instead of from cin, and -l snapshot
+//    starts from a saved tree instead of an empty one.  -j journal
+//    replays a journal on top of that and then logs every change to
+//    it, committing every -i milliseconds or every -b bytes.  -s
+//    socket serves the tree to clients on a Unix domain socket
+//    instead of reading commands.  -S file writes the stats to the
+//    file as JSON on exit.
+
+string script_name;
+string snapshot_name;
+string journal_name;
+string socket_name;
+string stats_name;
+journal_options journal_settings;
+
+size_t number_option (char option, const char* text) {
+   char* end = nullptr;
+   unsigned long long number = strtoull (text, &end, 10);
+   if (*text == '\0' or *end != '\0') {
+      complain() << "-" << option << " " << text
+                 << ": invalid number" << endl;
+   }
+   return number;
+}
 
 void scan_options (int argc, char** argv) {
    opterr = 0;
    for (;;) {
-      int option = getopt (argc, argv, "@:");
+      int option = getopt (argc, argv, "@:S:b:f:i:j:l:s:");
       if (option == EOF) break;
       switch (option) {
          case '@':
             debugflags::setflags (optarg);
             break;
+         case 'f':
+            script_name = optarg;
+            break;
+         case 'S':
+            stats_name = optarg;
+            break;
+         case 'b':
+            journal_settings.threshold = number_option ('b', optarg);
+            break;
+         case 'i':
+            journal_settings.interval = chrono::milliseconds (
+                                  number_option ('i', optarg));
+            break;
+         case 'j':
+            journal_name = optarg;
+            break;
+         case 'l':
+            snapshot_name = optarg;
+            break;
+         case 's':
+            socket_name = optarg;
+            break;
          default:
             complain() << "-" << static_cast<char> (option)
                        << ": invalid option" << endl;
@@ -37,6 +90,35 @@ void scan_options (int argc, char** argv) {
 }
 
 
+// run_script -
+//    Batch mode.  The script is mapped into memory and each line is
+//    split into views of the mapping, which are handed straight to
+//    the command, so commands are read and dispatched without
+//    allocating.  Output is flushed only when the buffer fills.
+//    The output is the same as that of reading the script from cin.
+
+void run_script (inode_state& state, const string& filename,
+                 bool need_echo) {
+   mapped_file script (filename);
+   string_view text = script.view();
+   viewvec words;
+   while (not text.empty()) {
+      output() << state.prompt();
+      size_t newline = text.find ('\n');
+      string_view line = text.substr (0, newline);
+      text.remove_prefix (newline == string_view::npos
+                          ? text.size() : newline + 1);
+      if (need_echo) output() << line << '\n';
+      split_words (line, words);
+      if (words.empty()) continue;
+      execute (state, words);
+   }
+   output() << state.prompt();
+   if (need_echo) output() << "^D";
+   output() << '\n';
+   DEBUGF ('y', "EOF");
+}
+
 // main -
 //    Main program which loops reading commands until end of file.
 
@@ -46,38 +128,75 @@ int main (int argc, char** argv) {
    cerr << boolalpha;
    cout << argv[0] << " build " << __DATE__ << " " << __TIME__ << endl;
    scan_options (argc, argv);
+   if (not socket_name.empty()) server::block_signals();
    bool need_echo = want_echo();
    inode_state state;
+   viewvec words;
+   if (not snapshot_name.empty()) {
+      execute (state, viewvec {"load", snapshot_name});
+   }
+   unique_ptr<journal> log;
+   if (not journal_name.empty()) {
+      try {
+         journal::replay (journal_name,
+                          [&state] (journal_op op, wordspan args) {
+                             state.replay (op, args);
+                          });
+         log = make_unique<journal> (journal_name, journal_settings);
+         state.attach (log.get());
+      }catch (runtime_error& error) {
+         complain() << journal_name << ": " << error.what()
+                    << ": not journaling" << endl;
+      }
+   }
    try {
-      for (;;) {
+      if (not socket_name.empty()) {
+         server (state, socket_name,
+                 max (thread::hardware_concurrency(), 1u)).run();
+      }else if (not script_name.empty()) {
+         // Nothing else writes through stdio, so iostreams need not
+         // stay synchronized with it.
+         ios::sync_with_stdio (false);
+         run_script (state, script_name, need_echo);
+      }else for (;;) {
          try {
             // Read a line, break at EOF, and echo print the prompt
             // if one is needed.
-            cout << state.prompt();
+            output() << state.prompt();
+            output().flush();
             string line;
             getline (cin, line);
             if (cin.eof()) {
-               if (need_echo) cout << "^D";
-               cout << endl;
+               if (need_echo) output() << "^D";
+               output() << '\n';
                DEBUGF ('y', "EOF");
                break;
             }
-            if (need_echo) cout << line << endl;
+            if (need_echo) output() << line << '\n';
    
             // Split the line into words and lookup the appropriate
             // function.  Complain or call it.
-            wordvec words = split (line, " \t");
-            DEBUGF ('y', "words = " << words);
-            command_fn fn = find_command_fn (words.at(0));
-            fn (state, words);
+            split_words (line, words);
+            if (words.empty()) continue;
+            execute (state, words);
          }catch (command_error& error) {
                complain() << error.what() << endl;
          }
       }
    } catch (ysh_exit&) {
       // This catch intentionally left blank.
+   } catch (mapping_error& error) {
+      complain() << error.what() << endl;
+   } catch (server_error& error) {
+      complain() << error.what() << endl;
    }
 
+   if (not stats_name.empty()) {
+      ofstream file (stats_name);
+      file << stats::json();
+      if (not file) complain() << stats_name << ": cannot write stats"
+                               << endl;
+   }
    return exit_status_message();
 }
 
@@ -0,0 +1,82 @@
+// $Id: mapfile.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "debug.h"
+#include "mapfile.h"
+
+mapping_error::mapping_error (const string& what):
+               runtime_error (what) {
+}
+
+mapped_file::mapped_file (const string& filename) {
+   int fd = open (filename.c_str(), O_RDONLY);
+   if (fd < 0) throw mapping_error (filename + ": " + strerror (errno));
+   struct stat status;
+   if (fstat (fd, &status) < 0) {
+      int error = errno;
+      close (fd);
+      throw mapping_error (filename + ": " + strerror (error));
+   }
+   length = status.st_size;
+   // An empty file cannot be mapped, and has nothing to map anyway.
+   if (length > 0) {
+      void* addr = mmap (nullptr, length, PROT_READ, MAP_PRIVATE,
+                         fd, 0);
+      if (addr == MAP_FAILED) {
+         int error = errno;
+         close (fd);
+         throw mapping_error (filename + ": " + strerror (error));
+      }
+      base = static_cast<const char*> (addr);
+      madvise (addr, length, MADV_SEQUENTIAL);
+   }
+   close (fd);
+   DEBUGF ('m', filename << ": " << length << " bytes mapped");
+}
+
+mapped_file::~mapped_file() {
+   if (base != nullptr) {
+      munmap (const_cast<char*> (base), length);
+   }
+}
+
+void mapped_file::release (size_t from, size_t to) const {
+   static const size_t page = sysconf (_SC_PAGESIZE);
+   from = (from + page - 1) / page * page;
+   to = to == length ? to : to / page * page;
+   if (base != nullptr and from < to) {
+      madvise (const_cast<char*> (base) + from, to - from,
+               MADV_DONTNEED);
+   }
+}
+
+
+// flush -
+//    Opens a file or directory and flushes it to disk.
+
+static bool flush (const string& filename) {
+   int fd = open (filename.c_str(), O_RDONLY);
+   if (fd < 0) return false;
+   bool good = fsync (fd) == 0;
+   int error = errno;
+   close (fd);
+   errno = error;
+   return good;
+}
+
+bool replace_file (const string& from, const string& to) {
+   string dir = filesystem::path (to).parent_path().string();
+   return flush (from)
+      and rename (from.c_str(), to.c_str()) == 0
+      and flush (dir.empty() ? "." : dir);
+}
@@ -0,0 +1,49 @@
+// $Id: mapfile.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// mapped_file -
+//    A host file mapped read-only into memory for the lifetime of
+//    the object.  The contents are available as a string_view, so
+//    they can be scanned and sliced without copying.  Throws a
+//    mapping_error if the file cannot be opened or mapped.
+// release -
+//    Drops the whole pages of a range from the process's memory, once
+//    they have been read and will not be needed again soon.  Reading
+//    them again reads the file again.
+// replace_file -
+//    Puts a finished file in place of another:  the new file is
+//    flushed to disk, renamed over the old one, and the directory
+//    flushed too, so a crash leaves either file whole, never a mix.
+//    A mapping of the old file stays good.  Returns false with errno
+//    set if any step fails.
+
+#ifndef __MAPFILE_H__
+#define __MAPFILE_H__
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+using namespace std;
+
+class mapping_error: public runtime_error {
+   public:
+      explicit mapping_error (const string& what);
+};
+
+class mapped_file {
+   private:
+      const char* base {nullptr};
+      size_t length {0};
+   public:
+      explicit mapped_file (const string& filename);
+      mapped_file (const mapped_file&) = delete;
+      mapped_file& operator= (const mapped_file&) = delete;
+      ~mapped_file();
+      string_view view() const { return {base, length}; }
+      size_t size() const { return length; }
+      void release (size_t from, size_t to) const;
+};
+
+bool replace_file (const string& from, const string& to);
+
+#endif
+
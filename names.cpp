@@ -0,0 +1,81 @@
+// $Id: names.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <iostream>
+#include <functional>
+#include <mutex>
+
+using namespace std;
+
+#include "debug.h"
+#include "names.h"
+
+// Chunks never move, so a name read by a lookup stays valid as the
+// table grows.  They are never freed, so names outlive every static
+// that might print one during exit.
+string* name_table::chunks_[max_chunks] {
+   new string[chunk_size] {"", ".", ".."},
+};
+size_t name_table::size_ {3};
+atomic<name_table::id_index*> name_table::index_ {first_index()};
+mutex name_table::lock_;
+
+name_table::id_index::id_index (size_t capacity):
+            mask (capacity - 1),
+            slots (make_unique<atomic<name_id>[]> (capacity)) {
+   for (size_t pos = 0; pos < capacity; ++pos) slots[pos] = no_name;
+}
+
+void name_table::id_index::place (name_id id) {
+   size_t pos = hash<string_view>() (name (id)) & mask;
+   while (slots[pos].load (memory_order_relaxed) != no_name) {
+      pos = (pos + 1) & mask;
+   }
+   // The text was written first, so whoever sees the id sees it.
+   slots[pos].store (id, memory_order_release);
+}
+
+name_table::id_index* name_table::first_index() {
+   id_index* index = new id_index (64);
+   for (name_id id: {empty, dot, dotdot}) index->place (id);
+   return index;
+}
+
+name_id name_table::intern (const string_view& name) {
+   name_id id = find (name);
+   if (id != no_name) return id;
+   lock_guard<mutex> guard (lock_);
+   id = find (name);
+   if (id != no_name) return id;
+   id = size_;
+   string*& chunk = chunks_[id >> chunk_bits];
+   if (chunk == nullptr) chunk = new string[chunk_size];
+   string& text = chunk[id & (chunk_size - 1)];
+   text = name;
+   ++size_;
+   id_index* index = index_.load (memory_order_relaxed);
+   if (size_ * 2 > index->mask + 1) {
+      // Readers still probing the old index find every name that was
+      // in it; the old one is never freed.
+      id_index* larger = new id_index ((index->mask + 1) * 2);
+      for (name_id old = 0; old < id; ++old) larger->place (old);
+      index_.store (larger, memory_order_release);
+      index = larger;
+   }
+   index->place (id);
+   DEBUGF ('n', "intern \"" << name << "\" as " << id);
+   return id;
+}
+
+name_id name_table::find (const string_view& name) {
+   const id_index& index = *index_.load (memory_order_acquire);
+   for (size_t pos = hash<string_view>() (name) & index.mask;;
+        pos = (pos + 1) & index.mask) {
+      name_id id = index.slots[pos].load (memory_order_acquire);
+      if (id == no_name or name_table::name (id) == name) return id;
+   }
+}
+
+size_t name_table::size() {
+   lock_guard<mutex> guard (lock_);
+   return size_;
+}
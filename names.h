@@ -0,0 +1,75 @@
+// $Id: names.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// name_table -
+//    Static table that stores each distinct file name once and hands
+//    out small integer ids for them.  Directories key their entries
+//    by id, so comparing or hashing a name is an integer operation,
+//    and the text is shared by every entry that uses the same name.
+//    Ids are never reused, so names live as long as the process.
+//    The empty name, dot, and dotdot have fixed ids.
+//    Names are kept in fixed-size chunks that never move, so name
+//    can be called from any thread without a lock:  a name is
+//    written before its id is handed out, and the id can only reach
+//    another thread through some later synchronization.  The map
+//    from text to id is an open-addressing index of atomic ids, so
+//    lookups take no lock and write nothing.  intern takes a lock,
+//    and grows the index by publishing a larger copy; old copies are
+//    kept, like the chunks, so a reader may go on probing one.
+// intern -
+//    Returns the id of a name, adding the name if it is new.
+// find -
+//    Returns the id of a name, or no_name if it was never interned.
+//    Lookups use this so that misses do not grow the table.
+// name -
+//    Returns the text of an id.
+
+#ifndef __NAMES_H__
+#define __NAMES_H__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+using namespace std;
+
+using name_id = uint32_t;
+
+class name_table {
+   private:
+      static constexpr size_t chunk_bits {12};
+      static constexpr size_t chunk_size {size_t (1) << chunk_bits};
+      static constexpr size_t max_chunks {
+         size_t (1) << (32 - chunk_bits)
+      };
+      // Slots hold no_name where empty.
+      struct id_index {
+         size_t mask;
+         unique_ptr<atomic<name_id>[]> slots;
+         explicit id_index (size_t capacity);
+         void place (name_id id);
+      };
+      static string* chunks_[max_chunks];
+      static size_t size_;
+      static atomic<id_index*> index_;
+      static mutex lock_;
+      static id_index* first_index();
+   public:
+      static constexpr name_id no_name = UINT32_MAX;
+      static constexpr name_id empty = 0;
+      static constexpr name_id dot = 1;
+      static constexpr name_id dotdot = 2;
+      static name_id intern (const string_view& name);
+      static name_id find (const string_view& name);
+      static const string& name (name_id id) {
+         return chunks_[id >> chunk_bits][id & (chunk_size - 1)];
+      }
+      static size_t size();
+      static bool less (name_id left, name_id right) {
+         return name (left) < name (right);
+      }
+};
+
+#endif
+
@@ -0,0 +1,156 @@
+// $Id: outbench.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// outbench -
+//    Measures the cost of listing output.  A tree is built, and lsr /
+//    is run through the shell's output_sink.  The lines it printed
+//    are then written again two ways:  the old way, with setw and
+//    endl through an ostream that issues one write(2) per flush as
+//    cout does on a pipe, and the new way, with column through an
+//    output_sink.  Output goes to /dev/null unless a file is named.
+//    Prints CSV:  method, lines, write calls, and milliseconds.
+
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+#include "file_sys.h"
+#include "util.h"
+
+using bench_clock = chrono::steady_clock;
+
+// counting_buf -
+//    Streambuf that buffers until sync or overflow, then writes to a
+//    file descriptor, counting the write calls.
+
+class counting_buf: public streambuf {
+   private:
+      int fd;
+      char buffer[8192];
+      size_t writes_ {0};
+      void drain() {
+         if (pptr() > pbase()) {
+            if (::write (fd, pbase(), pptr() - pbase()) < 0) return;
+            ++writes_;
+         }
+         setp (buffer, buffer + sizeof buffer);
+      }
+   protected:
+      int_type overflow (int_type chr) override {
+         drain();
+         if (chr != traits_type::eof()) sputc (chr);
+         return 0;
+      }
+      int sync() override { drain(); return 0; }
+   public:
+      explicit counting_buf (int fd_): fd (fd_) {
+         setp (buffer, buffer + sizeof buffer);
+      }
+      size_t writes() const { return writes_; }
+};
+
+struct line {
+   long long nr;
+   long long size;
+   string name;
+};
+
+void build_tree (inode_state& state, int dirs, int files) {
+   wordvec content {"alpha", "beta", "gamma"};
+   viewvec views (content.begin(), content.end());
+   for (int dir = 0; dir < dirs; ++dir) {
+      string name = "d" + to_string (dir);
+      state.mkdir (name);
+      state.cd (name);
+      for (int file = 0; file < files; ++file) {
+         state.mkfile ("f" + to_string (file), views);
+      }
+      state.cd ("/");
+   }
+}
+
+template <typename fn_t>
+double time_ms (fn_t fn) {
+   auto start = bench_clock::now();
+   fn();
+   chrono::duration<double,milli> spent = bench_clock::now() - start;
+   return spent.count();
+}
+
+int main (int argc, char** argv) {
+   int dirs = argc > 1 ? stoi (argv[1]) : 1000;
+   int files = argc > 2 ? stoi (argv[2]) : 100;
+   const char* target = argc > 3 ? argv[3] : "/dev/null";
+   int sink_fd = open (target, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+   if (sink_fd < 0) {
+      cerr << target << ": cannot open" << endl;
+      return EXIT_FAILURE;
+   }
+   inode_state state;
+   build_tree (state, dirs, files);
+
+   // Run the real lsr with the sink on stdout redirected to a
+   // temporary file, then read back its lines for the other two
+   // methods.
+   char capture[] = "/tmp/outbenchXXXXXX";
+   int capture_fd = mkstemp (capture);
+   int saved_stdout = dup (STDOUT_FILENO);
+   output().flush();
+   dup2 (capture_fd, STDOUT_FILENO);
+   size_t writes_before = output().writes();
+   double lsr_ms = time_ms ([&] {
+      state.lsr ("/");
+      output().flush();
+   });
+   size_t lsr_writes = output().writes() - writes_before;
+   dup2 (saved_stdout, STDOUT_FILENO);
+   close (saved_stdout);
+   close (capture_fd);
+
+   vector<line> lines;
+   ifstream listing (capture);
+   for (string text; getline (listing, text);) {
+      istringstream words (text);
+      line item;
+      if (words >> item.nr >> item.size >> item.name) {
+         lines.push_back (item);
+      }
+   }
+   unlink (capture);
+
+   counting_buf buf (sink_fd);
+   ostream old_out (&buf);
+   double old_ms = time_ms ([&] {
+      for (const auto& item: lines) {
+         old_out << setw (8) << item.nr << setw (8) << item.size
+                 << "  " << item.name << endl;
+      }
+   });
+
+   output_sink new_out (sink_fd);
+   double new_ms = time_ms ([&] {
+      for (const auto& item: lines) {
+         new_out << column (item.nr, 8) << column (item.size, 8)
+                 << "  " << item.name << '\n';
+      }
+      new_out.flush();
+   });
+
+   cout << "method,lines,writes,ms" << endl;
+   cout << "lsr," << lines.size() << "," << lsr_writes << ","
+        << lsr_ms << endl;
+   cout << "ostream_endl," << lines.size() << "," << buf.writes()
+        << "," << old_ms << endl;
+   cout << "output_sink," << lines.size() << "," << new_out.writes()
+        << "," << new_ms << endl;
+   return EXIT_SUCCESS;
+}
+
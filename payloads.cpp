@@ -0,0 +1,220 @@
+// $Id: payloads.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+
+using namespace std;
+
+#include "debug.h"
+#include "payloads.h"
+
+__extension__ using uint128 = unsigned __int128;
+
+// fold_multiply -
+//    The high and low halves of the full product, xored, so that
+//    every bit of either factor reaches every bit of the result.
+
+static inline uint64_t fold_multiply (uint64_t left, uint64_t right) {
+   uint128 product = static_cast<uint128> (left) * right;
+   return static_cast<uint64_t> (product)
+        ^ static_cast<uint64_t> (product >> 64);
+}
+
+void payload_hasher::mix (const unsigned char* block) {
+   uint64_t first;
+   uint64_t second;
+   memcpy (&first, block, sizeof first);
+   memcpy (&second, block + sizeof first, sizeof second);
+   uint64_t low = fold_multiply (lanes[0] ^ first,
+                  lanes[1] ^ second ^ 0x9E3779B97F4A7C15);
+   lanes[1] = fold_multiply (lanes[1] ^ second,
+              lanes[0] ^ first ^ 0xC2B2AE3D27D4EB4F);
+   lanes[0] = low;
+}
+
+// mix_pending -
+//    Hashes the whole blocks gathered so far, and moves the rest, less
+//    than a block, to the front.
+
+void payload_hasher::mix_pending() {
+   size_t whole = pending_size / block_size * block_size;
+   for (size_t at = 0; at < whole; at += block_size) {
+      mix (pending + at);
+   }
+   memmove (pending, pending + whole, pending_size - whole);
+   pending_size -= whole;
+}
+
+void payload_hasher::update (string_view text) {
+   mix_pending();
+   const unsigned char* itor =
+         reinterpret_cast<const unsigned char*> (text.data());
+   size_t left = text.size();
+   total += left;
+   if (pending_size > 0) {
+      size_t take = min (block_size - pending_size, left);
+      memcpy (pending + pending_size, itor, take);
+      pending_size += take;
+      itor += take;
+      left -= take;
+      if (pending_size < block_size) return;
+      mix (pending);
+      pending_size = 0;
+   }
+   for (; left >= block_size; left -= block_size) {
+      mix (itor);
+      itor += block_size;
+   }
+   memcpy (pending, itor, left);
+   pending_size = left;
+}
+
+payload_key payload_hasher::finish() {
+   mix_pending();
+   if (pending_size > 0) {
+      memset (pending + pending_size, 0, block_size - pending_size);
+      mix (pending);
+      pending_size = 0;
+   }
+   payload_key key;
+   key.low = fold_multiply (lanes[0] ^ 0x165667B19E3779F9,
+                            lanes[1] ^ total);
+   key.high = fold_multiply (lanes[1] ^ 0xD6E8FEB86659FD93,
+                             key.low ^ total);
+   return key;
+}
+
+payload_key payload_hasher::hash (string_view text) {
+   payload_hasher hasher;
+   hasher.update (text);
+   return hasher.finish();
+}
+
+// A block is its header and then the bytes its file asked for.  Only
+// blocks whose key was free when they were shared are listed; one
+// that lost to a collision is counted, but found by no one.
+
+struct payload_store::header {
+   payload_key key;
+   size_t bytes {0};
+   uint32_t length {0};
+   uint32_t users {1};
+   bool listed {false};
+};
+
+struct payload_store::key_hash {
+   size_t operator() (const payload_key& key) const {
+      return key.low;
+   }
+};
+
+struct payload_store::shard {
+   mutex lock;
+   unordered_map<payload_key,header*,key_hash> blocks;
+   payload_usage used;
+};
+
+// The shards are never freed, so a file let go by some static during
+// exit still finds its shard.
+
+payload_store::shard* payload_store::shards() {
+   static shard* all = new shard[shard_count];
+   return all;
+}
+
+payload_store::header* payload_store::head (char* data) {
+   return reinterpret_cast<header*> (data - sizeof (header));
+}
+
+payload_store::shard& payload_store::shard_of (const payload_key& key) {
+   // The map hashes low, so high picks the shard.
+   return shards()[key.high % shard_count];
+}
+
+char* payload_store::find (const payload_key& key, size_t length,
+                           const function<bool (string_view)>& same) {
+   shard& part = shard_of (key);
+   lock_guard<mutex> guard (part.lock);
+   auto found = part.blocks.find (key);
+   if (found == part.blocks.end()) return nullptr;
+   header* block = found->second;
+   char* data = reinterpret_cast<char*> (block + 1);
+   if (block->length != length or not same ({data, length})) {
+      return nullptr;
+   }
+   ++block->users;
+   ++part.used.files;
+   part.used.logical += block->bytes;
+   DEBUGF ('f', "shared " << block->bytes << " bytes, "
+          << block->users << " users");
+   return data;
+}
+
+char* payload_store::make (size_t bytes) {
+   char* raw = static_cast<char*> (::operator new (sizeof (header)
+                                                   + bytes));
+   header* block = new (raw) header;
+   block->bytes = bytes;
+   return raw + sizeof (header);
+}
+
+char* payload_store::share (char* data, const payload_key& key,
+                            size_t length) {
+   header* block = head (data);
+   block->key = key;
+   block->length = length;
+   shard& part = shard_of (key);
+   header* first = nullptr;
+   {
+      lock_guard<mutex> guard (part.lock);
+      auto [found, added] = part.blocks.try_emplace (key, block);
+      first = found->second;
+      if (added or first->length != length
+          or memcmp (first + 1, data, length) != 0) {
+         block->listed = added;
+         ++part.used.files;
+         ++part.used.payloads;
+         part.used.logical += block->bytes;
+         part.used.physical += block->bytes;
+         return data;
+      }
+      ++first->users;
+      ++part.used.files;
+      part.used.logical += first->bytes;
+   }
+   ::operator delete (block);
+   return reinterpret_cast<char*> (first + 1);
+}
+
+void payload_store::drop (char* data) {
+   header* block = head (data);
+   shard& part = shard_of (block->key);
+   {
+      lock_guard<mutex> guard (part.lock);
+      --part.used.files;
+      part.used.logical -= block->bytes;
+      if (--block->users > 0) return;
+      if (block->listed) part.blocks.erase (block->key);
+      --part.used.payloads;
+      part.used.physical -= block->bytes;
+   }
+   ::operator delete (block);
+}
+
+payload_usage payload_store::usage() {
+   payload_usage result;
+   for (size_t index = 0; index < shard_count; ++index) {
+      shard& part = shards()[index];
+      lock_guard<mutex> guard (part.lock);
+      result.files += part.used.files;
+      result.payloads += part.used.payloads;
+      result.logical += part.used.logical;
+      result.physical += part.used.physical;
+   }
+   return result;
+}
+
@@ -0,0 +1,135 @@
+// $Id: payloads.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// payload_store -
+//    Static store of the heap blocks that hold the text and word
+//    offsets of plain files, keyed by a 128-bit hash of the text, so
+//    that every file with the same text shares one block.  Each block
+//    starts with a header holding its key and the number of files
+//    that use it, and is freed when the last one lets it go.  A
+//    file's text never changes once the file is published, so a block
+//    is shared as it is, with no copy on write.  The hash is not
+//    trusted alone:  a block is shared only if its text is the same
+//    byte for byte, so a collision costs a compare and a block of its
+//    own, never a wrong file.  Blocks are spread over shards by key,
+//    each with its own lock, so files made on different threads
+//    seldom wait on each other.  Inline text, and text borrowed from
+//    a snapshot, are not in the store, since they have no heap block.
+// payload_hasher -
+//    Hashes text fed to it in pieces as if it were one string, so the
+//    words of a file can be hashed before they are joined.  Each 16
+//    bytes are folded into two 64-bit lanes by 128-bit multiplies,
+//    and the length into both at the end.  Text is gathered a few
+//    hundred bytes at a time, and only whole blocks are hashed, so
+//    short pieces cost about what copying them would.
+// update, update_joined -
+//    Hash more text, or pieces of text as if joined with between.
+//    update_joined keeps its place in a local, not the member, so
+//    that no call to copy a piece makes the loop wait on a load of it.
+// find -
+//    Returns the block with the given key and text, with one more
+//    user, or nullptr if there is none.  same is called with the text
+//    of each candidate, under the shard's lock.
+// make -
+//    Returns a new block of the given size, after its header.
+// share -
+//    Lists a block from make, once it is filled in, under the key of
+//    its text, and returns it.  If a block with the same text was
+//    listed first, frees this one and returns that one instead.
+// drop -
+//    Lets go of one use of a shared block, freeing it with the last.
+// usage -
+//    The files and blocks in the store, and the bytes they hold:
+//    logical counts a block once for each file that uses it, and
+//    physical counts it once.
+
+#ifndef __PAYLOADS_H__
+#define __PAYLOADS_H__
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string_view>
+using namespace std;
+
+struct payload_key {
+   uint64_t low {0};
+   uint64_t high {0};
+   bool operator== (const payload_key& that) const {
+      return low == that.low and high == that.high;
+   }
+};
+
+class payload_hasher {
+   private:
+      static constexpr size_t block_size {16};
+      uint64_t lanes[2] {0x243F6A8885A308D3, 0x13198A2E03707344};
+      unsigned char pending[256];
+      size_t pending_size {0};
+      uint64_t total {0};
+      void mix (const unsigned char* block);
+      void mix_pending();
+   public:
+      void update (string_view text);
+      template <typename range_t>
+      void update_joined (const range_t& pieces, char between);
+      payload_key finish();
+      static payload_key hash (string_view text);
+};
+
+template <typename range_t>
+void payload_hasher::update_joined (const range_t& pieces,
+                                    char between) {
+   size_t at = pending_size;
+   uint64_t added = 0;
+   bool first = true;
+   for (string_view piece: pieces) {
+      if (at + piece.size() + 1 > sizeof pending) {
+         pending_size = at;
+         total += added;
+         added = 0;
+         if (not first) update ({&between, 1});
+         update (piece);
+         at = pending_size;
+      }else {
+         if (not first) {
+            pending[at++] = between;
+            ++added;
+         }
+         memcpy (pending + at, piece.data(), piece.size());
+         at += piece.size();
+         added += piece.size();
+      }
+      first = false;
+   }
+   pending_size = at;
+   total += added;
+}
+
+struct payload_usage {
+   size_t files {0};
+   size_t payloads {0};
+   size_t logical {0};
+   size_t physical {0};
+};
+
+class payload_store {
+   private:
+      static constexpr size_t shard_count {16};
+      struct header;
+      struct key_hash;
+      struct shard;
+      static shard* shards();
+      static header* head (char* data);
+      static shard& shard_of (const payload_key& key);
+   public:
+      static char* find (const payload_key& key, size_t length,
+                         const function<bool (string_view)>& same);
+      static char* make (size_t bytes);
+      static char* share (char* data, const payload_key& key,
+                          size_t length);
+      static void drop (char* data);
+      static payload_usage usage();
+};
+
+#endif
+
@@ -0,0 +1,111 @@
+// $Id: rcu.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+using namespace std;
+
+#include "debug.h"
+#include "rcu.h"
+#include "trace.h"
+
+rcu::reader_slot rcu::slots[rcu::max_threads];
+atomic<size_t> rcu::slots_used {0};
+atomic<uint64_t> rcu::epoch {1};
+thread_local rcu::thread_state rcu::current;
+
+rcu::thread_state::~thread_state() {
+   if (slot != nullptr) slot->taken.store (false, memory_order_release);
+}
+
+// claim -
+//    Gives a thread a slot the first time it reads.  Slots of threads
+//    that have ended are used again, so the scan in synchronize only
+//    grows with the most threads alive at once.
+
+rcu::reader_slot* rcu::claim() {
+   for (size_t index = 0; index < max_threads; ++index) {
+      bool taken = false;
+      if (slots[index].taken.load (memory_order_relaxed)
+          or not slots[index].taken.compare_exchange_strong (taken,
+                                                             true)) {
+         continue;
+      }
+      size_t used = slots_used.load();
+      while (used <= index
+             and not slots_used.compare_exchange_weak (used,
+                                                       index + 1)) {
+      }
+      return &slots[index];
+   }
+   throw runtime_error ("rcu: more than " + to_string (max_threads)
+                        + " threads");
+}
+
+void rcu::synchronize() {
+   // A reader whose slot holds an epoch older than target began
+   // before this call and may hold something retired before it.
+   uint64_t target = epoch.fetch_add (1) + 1;
+   atomic_thread_fence (memory_order_seq_cst);
+   size_t used = slots_used.load();
+   for (size_t index = 0; index < used; ++index) {
+      for (unsigned spins = 0;; ++spins) {
+         uint64_t seen = slots[index].epoch.load (memory_order_acquire);
+         if (seen == 0 or seen >= target) break;
+         if (spins < 64) {
+            this_thread::yield();
+         }else {
+            this_thread::sleep_for (chrono::microseconds (50));
+         }
+      }
+   }
+}
+
+rcu::rcu(): worker (&rcu::work, this) {
+}
+
+rcu::~rcu() {
+   {
+      lock_guard<mutex> guard (lock);
+      stopping = true;
+   }
+   ready.notify_one();
+   worker.join();
+}
+
+rcu& rcu::shared() {
+   static rcu instance;
+   return instance;
+}
+
+void rcu::retire (function<void()> fn) {
+   rcu& self = shared();
+   {
+      lock_guard<mutex> guard (self.lock);
+      self.pending.push_back (move (fn));
+   }
+   self.ready.notify_one();
+}
+
+void rcu::work() {
+   vector<function<void()>> batch;
+   for (;;) {
+      {
+         unique_lock<mutex> guard (lock);
+         ready.wait (guard, [this] {
+            return stopping or not pending.empty();
+         });
+         if (pending.empty()) return;
+         batch.swap (pending);
+      }
+      // Everything retired while the last grace period went by shares
+      // the next one.
+      synchronize();
+      for (auto& fn: batch) fn();
+      DEBUGF ('g', batch.size() << " retired after a grace period");
+      TRACE ('g', "grace period", batch.size());
+      batch.clear();
+   }
+}
+
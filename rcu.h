@@ -0,0 +1,100 @@
+// $Id: rcu.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// rcu -
+//    Read-copy-update, which lets readers walk the tree while it
+//    changes without taking any lock.  A writer never changes what a
+//    reader may be looking at:  it makes a changed copy, publishes it
+//    with one atomic store, and retires the old one, which is freed
+//    only after a grace period, once every reader that might still
+//    hold it is done.  Readers are tracked by epoch.  Each thread has
+//    a slot of its own, on a cache line of its own, and entering a
+//    read-side section stores the current epoch there, followed by a
+//    fence, and leaving clears it.  Neither takes a lock or does any
+//    read-modify-write, so readers on different cores write nothing
+//    in common.
+// rcu_reader -
+//    Marks a read-side section for as long as it lives.  Pointers
+//    read from a published structure inside the section stay good
+//    until it ends.  Sections nest, and only the outermost counts.  A
+//    thread inside a section must never wait for a grace period, nor
+//    for a thread that does.
+// synchronize -
+//    Waits out a grace period:  returns once every section that had
+//    begun when it was called has ended.
+// retire -
+//    Runs a function, usually one that frees something, after a grace
+//    period.  Retired functions are run in the order they came, in
+//    batches that share one grace period, by a background thread, so
+//    a writer never waits.  At exit, whatever is queued is run.
+
+#ifndef __RCU_H__
+#define __RCU_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+class rcu {
+   friend class rcu_reader;
+   private:
+      struct alignas (64) reader_slot {
+         atomic<uint64_t> epoch {0};  // 0 when outside any section
+         atomic<bool> taken {false};
+      };
+      struct thread_state {
+         reader_slot* slot {nullptr};
+         unsigned depth {0};
+         ~thread_state();
+      };
+      static constexpr size_t max_threads {1024};
+      static reader_slot slots[max_threads];
+      static atomic<size_t> slots_used;
+      static atomic<uint64_t> epoch;
+      static thread_local thread_state current;
+      mutex lock;
+      condition_variable ready;
+      vector<function<void()>> pending;
+      bool stopping {false};
+      thread worker;
+      static reader_slot* claim();
+      void work();
+      rcu();
+      ~rcu();
+      static rcu& shared();
+   public:
+      rcu (const rcu&) = delete;
+      rcu& operator= (const rcu&) = delete;
+      static void synchronize();
+      static void retire (function<void()> fn);
+};
+
+class rcu_reader {
+   public:
+      rcu_reader() {
+         rcu::thread_state& self = rcu::current;
+         if (self.depth++ > 0) return;
+         if (self.slot == nullptr) self.slot = rcu::claim();
+         self.slot->epoch.store (rcu::epoch.load(),
+                                 memory_order_relaxed);
+         // Orders the store before every read in the section, so a
+         // grace period that misses this reader began after those
+         // reads could see anything it retires.
+         atomic_thread_fence (memory_order_seq_cst);
+      }
+      ~rcu_reader() {
+         rcu::thread_state& self = rcu::current;
+         if (--self.depth == 0) {
+            self.slot->epoch.store (0, memory_order_release);
+         }
+      }
+      rcu_reader (const rcu_reader&) = delete;
+      rcu_reader& operator= (const rcu_reader&) = delete;
+};
+
+#endif
+
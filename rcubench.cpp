@@ -0,0 +1,126 @@
+// $Id: rcubench.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// rcubench -
+//    Measures how reads scale with threads while the tree changes.
+//    A tree of dirs directories with files files each is built.  For
+//    each count of reader threads, from 1 doubling up to the number
+//    of hardware threads, every reader runs ls, cat, and pwd in a
+//    session of its own on the shared tree, writing into memory,
+//    while one more thread makes and removes files in / throughout.
+//    Prints CSV:  readers, reads per second in all, reads per second
+//    per reader, and changes per second made by the writer.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#include "commands.h"
+#include "file_sys.h"
+#include "util.h"
+
+using bench_clock = chrono::steady_clock;
+
+void build_tree (inode_state& state, int dirs, int files) {
+   wordvec content {"alpha", "beta", "gamma"};
+   viewvec views (content.begin(), content.end());
+   for (int dir = 0; dir < dirs; ++dir) {
+      string name = "d" + to_string (dir);
+      state.mkdir (name);
+      state.cd (name);
+      for (int file = 0; file < files; ++file) {
+         state.mkfile ("f" + to_string (file), views);
+      }
+      state.cd ("/");
+   }
+}
+
+// reader -
+//    Runs reads until told to stop, and counts them.
+
+void reader (inode_state::tree_ptr tree, int dirs, int files,
+             const atomic<bool>& stop, size_t& reads) {
+   inode_state state (tree);
+   output_sink out;
+   ostringstream errors;
+   output_scope scope (out, errors);
+   unsigned seed = hash<thread::id>() (this_thread::get_id());
+   size_t count = 0;
+   while (not stop.load (memory_order_relaxed)) {
+      seed = seed * 1103515245 + 12345;
+      string dir = "/d" + to_string (seed % dirs);
+      string file = dir + "/f" + to_string ((seed >> 8) % files);
+      execute (state, viewvec {"ls", dir});
+      execute (state, viewvec {"cat", file});
+      execute (state, viewvec {"pwd"});
+      out.clear();
+      count += 3;
+   }
+   reads = count;
+}
+
+// writer -
+//    Makes and removes files in / until told to stop.
+
+void writer (inode_state::tree_ptr tree, const atomic<bool>& stop,
+             size_t& changes) {
+   inode_state state (tree);
+   output_sink out;
+   ostringstream errors;
+   output_scope scope (out, errors);
+   size_t count = 0;
+   for (int round = 0; not stop.load (memory_order_relaxed);
+        ++round) {
+      string name = "w" + to_string (round % 64);
+      execute (state, viewvec {"make", name, "changed"});
+      if (round % 64 == 63) {
+         for (int index = 0; index < 64; ++index) {
+            execute (state, viewvec {"rm", "w" + to_string (index)});
+         }
+         count += 64;
+      }
+      out.clear();
+      ++count;
+   }
+   changes = count;
+}
+
+int main (int argc, char** argv) {
+   int dirs = argc > 1 ? stoi (argv[1]) : 100;
+   int files = argc > 2 ? stoi (argv[2]) : 100;
+   double seconds = argc > 3 ? stod (argv[3]) : 1.0;
+   unsigned most = max (thread::hardware_concurrency(), 1u);
+   inode_state state;
+   build_tree (state, dirs, files);
+
+   cout << "readers,reads_per_sec,per_reader,changes_per_sec" << endl;
+   for (unsigned readers = 1; readers <= most; readers *= 2) {
+      atomic<bool> stop {false};
+      vector<size_t> reads (readers);
+      size_t changes = 0;
+      vector<thread> threads;
+      auto start = bench_clock::now();
+      for (unsigned index = 0; index < readers; ++index) {
+         threads.emplace_back (reader, state.tree(), dirs, files,
+                               cref (stop), ref (reads[index]));
+      }
+      threads.emplace_back (writer, state.tree(), cref (stop),
+                            ref (changes));
+      this_thread::sleep_for (chrono::duration<double> (seconds));
+      stop = true;
+      for (auto& each: threads) each.join();
+      chrono::duration<double> spent = bench_clock::now() - start;
+      size_t total = 0;
+      for (size_t count: reads) total += count;
+      double rate = total / spent.count();
+      cout << readers << "," << rate << "," << rate / readers << ","
+           << changes / spent.count() << endl;
+   }
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+// $Id: reclaim.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+#include "commands.h"
+#include "debug.h"
+#include "rcu.h"
+#include "reclaim.h"
+#include "slab.h"
+#include "trace.h"
+
+reclaimer::reclaimer(): worker (&reclaimer::work, this) {
+}
+
+reclaimer::~reclaimer() {
+   {
+      lock_guard<mutex> guard (lock);
+      stopping = true;
+   }
+   ready.notify_one();
+   worker.join();
+}
+
+void reclaimer::retire (inode_ptr subtree) {
+   subtree_totals count = subtree->contents->usage();
+   pending += count.files + count.dirs;
+   {
+      lock_guard<mutex> guard (lock);
+      queue.push_back (move (subtree));
+   }
+   ready.notify_one();
+}
+
+void reclaimer::wait() {
+   unique_lock<mutex> guard (lock);
+   drained.wait (guard, [this] { return queue.empty() and not busy; });
+}
+
+pair<size_t,size_t> reclaimer::queued() {
+   lock_guard<mutex> guard (lock);
+   return {queue.size(), pending};
+}
+
+void reclaimer::work() {
+   for (;;) {
+      inode_ptr subtree;
+      {
+         unique_lock<mutex> guard (lock);
+         busy = false;
+         if (queue.empty()) drained.notify_all();
+         ready.wait (guard, [this] {
+            return stopping or not queue.empty();
+         });
+         if (queue.empty()) return;
+         subtree = move (queue.front());
+         queue.pop_front();
+         busy = true;
+      }
+      tear_down (move (subtree));
+   }
+}
+
+void reclaimer::tear_down (inode_ptr subtree) {
+   // Readers may still be inside the subtree until a grace period
+   // has gone by.  After that, each directory hands over the links
+   // of its children before it is released, so no destructor frees
+   // another and none recurses.
+   rcu::synchronize();
+   size_t count = 0;
+   vector<inode_ptr> nodes {move (subtree)};
+   while (not nodes.empty()) {
+      inode_ptr node = move (nodes.back());
+      nodes.pop_back();
+      if (node->this_type == file_type::DIRECTORY_TYPE) {
+         directory& dir = static_cast<directory&> (*node->contents);
+         // A directory never expanded from its snapshot has nothing
+         // below it in memory, so its subtree is done at once.
+         if (dir.unexpanded) {
+            size_t below = dir.totals.files + dir.totals.dirs;
+            pending -= below;
+            count += below;
+         }
+         for (const auto& entry: *dir.dirents.load()) {
+            if (entry.first != name_table::dot
+                and entry.first != name_table::dotdot) {
+               nodes.push_back (move (entry.second->link));
+            }
+         }
+      }
+      node = nullptr;
+      --pending;
+      ++count;
+   }
+   reclaimed_ += count;
+   DEBUGF ('r', count << " inodes reclaimed");
+   TRACE ('r', "reclaimed", count);
+}
+
+reclaimer& reclaimer::shared() {
+   static reclaimer instance;
+   return instance;
+}
+
+// fn_reclaim -
+//    Shows how much rmr has left for the reclaimer to free:  the
+//    subtrees waiting, the inodes in them, and the inodes freed so
+//    far.  Then the bytes the slabs hold and those in use:  a freed
+//    inode goes back to its slab, not to the system, so the first
+//    does not fall.  With "wait", first waits for the queue to empty.
+
+void fn_reclaim ([[maybe_unused]] inode_state& state, wordspan words) {
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   reclaimer& pool = reclaimer::shared();
+   if (words.size() > 1) {
+      if (words[1] != "wait") {
+         throw command_error (string (words[0]) + ": "
+                              + string (words[1]) + ": bad option");
+      }
+      pool.wait();
+   }
+   auto [subtrees, inodes] = pool.queued();
+   output() << column (subtrees, 8) << column (inodes, 12)
+            << column (pool.reclaimed(), 12)
+            << column (slab_pool::held_bytes(), 12)
+            << column (slab_pool::live_bytes(), 12) << '\n';
+}
+
+static command_registrar reg_reclaim {"reclaim", fn_reclaim};
+
@@ -0,0 +1,66 @@
+// $Id: reclaim.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// reclaimer -
+//    A background thread that destroys subtrees removed by rmr.  rmr
+//    only unlinks a subtree and retires it here, so the command
+//    returns at once however large the subtree is.  Each subtree is
+//    kept until a grace period has gone by, for readers that may
+//    still be inside it.  Subtrees are torn
+//    down in the order they were retired, one inode at a time with an
+//    explicit stack, so the shell can allocate between any two of
+//    them and deep trees cannot overflow the call stack.  The thread
+//    never sleeps while work is queued, so memory comes back as fast
+//    as one core can free it.
+// retire -
+//    Queues a subtree, by its link, once it is no longer linked into
+//    the tree.
+// wait -
+//    Blocks until everything retired so far has been destroyed.
+// queued -
+//    The number of subtrees waiting, and the number of inodes in
+//    them and in the subtree being torn down.
+// reclaimed -
+//    The number of inodes destroyed since the shell started.
+// shared -
+//    The process-wide reclaimer, started the first time it is used.
+//    At exit it finishes its queue before the process ends.
+
+#ifndef __RECLAIM_H__
+#define __RECLAIM_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+using namespace std;
+
+#include "file_sys.h"
+
+class reclaimer {
+   private:
+      deque<inode_ptr> queue;
+      mutex lock;
+      condition_variable ready;
+      condition_variable drained;
+      bool stopping {false};
+      bool busy {false};
+      atomic<size_t> pending {0};
+      atomic<size_t> reclaimed_ {0};
+      thread worker;
+      void work();
+      void tear_down (inode_ptr subtree);
+   public:
+      reclaimer();
+      reclaimer (const reclaimer&) = delete;
+      reclaimer& operator= (const reclaimer&) = delete;
+      ~reclaimer();
+      void retire (inode_ptr subtree);
+      void wait();
+      pair<size_t,size_t> queued();
+      size_t reclaimed() const { return reclaimed_; }
+      static reclaimer& shared();
+};
+
+#endif
+
@@ -0,0 +1,371 @@
+// $Id: server.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <optional>
+#include <sstream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "commands.h"
+#include "debug.h"
+#include "server.h"
+#include "stats.h"
+#include "trace.h"
+
+// server::session -
+//    One connection.  input and unsent belong to the event loop.
+//    While running is set, batch, out, errors, exited, and the state
+//    belong to the command thread running the batch; the loop sets
+//    running and the thread hands the session back through finished.
+//    The state is made by a command thread too, as the session's
+//    first job, since joining the tree takes its lock.
+
+struct server::session {
+   int fd;
+   optional<inode_state> state;
+   string input;        // read, not yet run
+   string batch;        // lines being run
+   string unsent;       // output not yet taken by the socket
+   size_t sent {0};
+   output_sink out;
+   ostringstream errors;
+   uint32_t events {0}; // what epoll watches for, if watched
+   bool watched {false};
+   bool running {false};
+   bool eof {false};    // the client has sent all it will
+   bool exited {false}; // exit was run, so the rest is ignored
+   bool broken {false}; // the connection failed
+   explicit session (int client_fd): fd (client_fd) {}
+};
+
+server_error::server_error (const string& what):
+              runtime_error (what) {
+}
+
+void server::fail (const string& what) {
+   throw server_error (path + ": " + what + ": " + strerror (errno));
+}
+
+void server::block_signals() {
+   sigset_t signals;
+   sigemptyset (&signals);
+   sigaddset (&signals, SIGINT);
+   sigaddset (&signals, SIGTERM);
+   pthread_sigmask (SIG_BLOCK, &signals, nullptr);
+}
+
+server::server (inode_state& state, const string& socket_path,
+                size_t threads):
+        tree (state.tree()), path (socket_path), runners (threads) {
+   sockaddr_un address {};
+   address.sun_family = AF_UNIX;
+   if (path.size() >= sizeof address.sun_path) {
+      throw server_error (path + ": socket name too long");
+   }
+   path.copy (address.sun_path, path.size());
+   // A socket left behind by a server that died is taken over.
+   struct stat status;
+   if (lstat (path.c_str(), &status) == 0
+       and S_ISSOCK (status.st_mode)) unlink (path.c_str());
+   listen_fd = socket (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK
+                       | SOCK_CLOEXEC, 0);
+   if (listen_fd < 0) fail ("socket");
+   if (bind (listen_fd, reinterpret_cast<sockaddr*> (&address),
+             sizeof address) < 0) {
+      close (listen_fd);
+      listen_fd = -1;
+      fail ("bind");
+   }
+   if (listen (listen_fd, SOMAXCONN) < 0) fail ("listen");
+   epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+   if (epoll_fd < 0) fail ("epoll_create1");
+   wake_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+   if (wake_fd < 0) fail ("eventfd");
+   sigset_t signals;
+   sigemptyset (&signals);
+   sigaddset (&signals, SIGINT);
+   sigaddset (&signals, SIGTERM);
+   signal_fd = signalfd (-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+   if (signal_fd < 0) fail ("signalfd");
+   watch (listen_fd, EPOLLIN);
+   watch (wake_fd, EPOLLIN);
+   watch (signal_fd, EPOLLIN);
+   DEBUGF ('v', path << ": " << threads << " command threads");
+}
+
+server::~server() {
+   for (int fd: {signal_fd, wake_fd, epoll_fd}) {
+      if (fd >= 0) close (fd);
+   }
+   if (listen_fd >= 0) {
+      close (listen_fd);
+      unlink (path.c_str());
+   }
+}
+
+void server::watch (int fd, uint32_t events) {
+   epoll_event event {};
+   event.events = events;
+   event.data.fd = fd;
+   if (epoll_ctl (epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+      fail ("epoll_ctl");
+   }
+}
+
+// rewatch -
+//    Watches a session for input unless it has ended or has a
+//    backlog, and for room to write while output is waiting.
+
+void server::rewatch (session& client) {
+   uint32_t events = 0;
+   if (not client.eof and not client.exited
+       and client.input.size() < backlog_limit) events |= EPOLLIN;
+   if (client.sent < client.unsent.size()) events |= EPOLLOUT;
+   if (client.watched and events == client.events) return;
+   epoll_event event {};
+   event.events = events;
+   event.data.fd = client.fd;
+   int op = client.watched ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+   if (epoll_ctl (epoll_fd, op, client.fd, &event) < 0) {
+      client.broken = true;
+      return;
+   }
+   client.watched = true;
+   client.events = events;
+}
+
+void server::accept_clients() {
+   for (;;) {
+      int fd = accept4 (listen_fd, nullptr, nullptr,
+                        SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) {
+         if (errno == EINTR) continue;
+         if (errno != EAGAIN and errno != EWOULDBLOCK) {
+            complain() << path << ": accept: " << strerror (errno)
+                       << endl;
+         }
+         return;
+      }
+      DEBUGF ('v', "session " << fd << " opened");
+      TRACE ('v', "session opened", fd);
+      auto added = make_unique<session> (fd);
+      session& client = *added;
+      sessions.emplace (fd, move (added));
+      client.running = true;
+      runners.submit ([this, &client] { open_session (client); });
+      service (client);
+   }
+}
+
+void server::read_client (session& client) {
+   char buffer[1 << 16];
+   while (client.input.size() < backlog_limit) {
+      ssize_t got = read (client.fd, buffer, sizeof buffer);
+      if (got > 0) {
+         client.input.append (buffer, got);
+         continue;
+      }
+      if (got == 0) {
+         client.eof = true;
+      }else if (errno == EINTR) {
+         continue;
+      }else if (errno != EAGAIN and errno != EWOULDBLOCK) {
+         client.broken = true;
+      }
+      return;
+   }
+}
+
+void server::write_client (session& client) {
+   while (client.sent < client.unsent.size()) {
+      ssize_t wrote = send (client.fd,
+                            client.unsent.data() + client.sent,
+                            client.unsent.size() - client.sent,
+                            MSG_NOSIGNAL);
+      if (wrote >= 0) {
+         client.sent += wrote;
+         stats::count (counter::BYTES_WRITTEN, wrote);
+      }else if (errno == EAGAIN or errno == EWOULDBLOCK) {
+         return;
+      }else if (errno != EINTR) {
+         client.broken = true;
+         return;
+      }
+   }
+   client.unsent.clear();
+   client.sent = 0;
+}
+
+// open_session -
+//    Joins a new session to the tree, which waits while a command
+//    holds the tree alone, and queues its first prompt.
+
+void server::open_session (session& client) {
+   client.state.emplace (tree);
+   client.out << client.state->prompt();
+   hand_back (client);
+}
+
+// dispatch -
+//    Hands every complete line read so far to a command thread, and
+//    at the end of input whatever is left as well.
+
+void server::dispatch (session& client) {
+   if (stopping or client.running or client.exited
+       or client.unsent.size() - client.sent >= backlog_limit) return;
+   size_t end = client.input.rfind ('\n');
+   if (end == string::npos) {
+      if (not client.eof or client.input.empty()) return;
+      end = client.input.size() - 1;
+   }
+   client.batch.assign (client.input, 0, end + 1);
+   client.input.erase (0, end + 1);
+   client.running = true;
+   runners.submit ([this, &client] { run_batch (client); });
+}
+
+void server::run_batch (session& client) {
+   {
+      output_scope scope (client.out, client.errors);
+      string_view text = client.batch;
+      viewvec words;
+      while (not text.empty() and not client.exited) {
+         size_t newline = text.find ('\n');
+         string_view line = text.substr (0, newline);
+         text.remove_prefix (newline == string_view::npos
+                             ? text.size() : newline + 1);
+         split_words (line, words);
+         if (not words.empty()) {
+            try {
+               execute (*client.state, words);
+            }catch (ysh_exit&) {
+               client.exited = true;
+            }catch (exception& error) {
+               complain() << error.what() << endl;
+            }
+         }
+         client.out << client.errors.str();
+         client.errors.str ("");
+         if (not client.exited) client.out << client.state->prompt();
+      }
+   }
+   hand_back (client);
+}
+
+// hand_back -
+//    Called by a command thread when it is done with a session, which
+//    the loop takes back in collect.
+
+void server::hand_back (session& client) {
+   {
+      lock_guard<mutex> guard (finished_lock);
+      finished.push_back (&client);
+   }
+   uint64_t one = 1;
+   if (write (wake_fd, &one, sizeof one) < 0) {
+      DEBUGF ('v', "eventfd: " << strerror (errno));
+   }
+}
+
+// collect -
+//    Takes back the sessions whose batches have finished and starts
+//    their output on its way.
+
+void server::collect() {
+   uint64_t count;
+   while (read (wake_fd, &count, sizeof count) > 0) {}
+   vector<session*> done;
+   {
+      lock_guard<mutex> guard (finished_lock);
+      done.swap (finished);
+   }
+   for (session* client: done) {
+      client->running = false;
+      client->unsent.append (client->out.text());
+      client->out.clear();
+      write_client (*client);
+      service (*client);
+   }
+}
+
+// service -
+//    Moves a session along after anything happens to it:  runs its
+//    next batch if it can, and closes it once there is nothing more
+//    to run or to send.  The session may be gone on return.
+
+void server::service (session& client) {
+   if (client.broken) {
+      if (client.watched) {
+         epoll_ctl (epoll_fd, EPOLL_CTL_DEL, client.fd, nullptr);
+         client.watched = false;
+      }
+      if (not client.running) close_client (client);
+      return;
+   }
+   dispatch (client);
+   if (not client.running and client.unsent.empty()
+       and (client.exited or (client.eof and client.input.empty()))) {
+      close_client (client);
+      return;
+   }
+   rewatch (client);
+}
+
+void server::close_client (session& client) {
+   DEBUGF ('v', "session " << client.fd << " closed");
+   TRACE ('v', "session closed", client.fd);
+   if (client.watched) {
+      epoll_ctl (epoll_fd, EPOLL_CTL_DEL, client.fd, nullptr);
+   }
+   int fd = client.fd;
+   close (fd);
+   sessions.erase (fd);
+}
+
+void server::run() {
+   constexpr int max_events {64};
+   epoll_event events[max_events];
+   while (not stopping) {
+      int count = epoll_wait (epoll_fd, events, max_events, -1);
+      if (count < 0) {
+         if (errno == EINTR) continue;
+         fail ("epoll_wait");
+      }
+      for (int index = 0; index < count; ++index) {
+         int fd = events[index].data.fd;
+         uint32_t ready = events[index].events;
+         if (fd == listen_fd) {
+            accept_clients();
+         }else if (fd == wake_fd) {
+            collect();
+         }else if (fd == signal_fd) {
+            stopping = true;
+         }else {
+            auto found = sessions.find (fd);
+            if (found == sessions.end()) continue;
+            session& client = *found->second;
+            if (ready & EPOLLIN) read_client (client);
+            if (ready & (EPOLLERR | EPOLLHUP)) client.broken = true;
+            if (ready & EPOLLOUT) write_client (client);
+            service (client);
+         }
+      }
+   }
+   DEBUGF ('v', path << ": stopping with " << sessions.size()
+          << " sessions");
+   runners.wait();
+   collect();
+   while (not sessions.empty()) {
+      close_client (*sessions.begin()->second);
+   }
+}
+
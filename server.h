@@ -0,0 +1,84 @@
+// $Id: server.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// server -
+//    Serves one tree to many clients at once over a Unix domain
+//    socket.  Each connection is a session of its own, with its own
+//    cwd and prompt on the shared tree.  A client sends command lines
+//    and reads back what the shell would print, with the prompt after
+//    each command and no echo.  One thread multiplexes every
+//    connection with epoll, reading lines and writing output without
+//    ever blocking.  The lines that have come in on a session are
+//    handed as one batch to a pool of command threads, and its next
+//    batch only once that one is done, so each session's commands run
+//    in order while those of different sessions run at once; reads
+//    take no lock, as inode_state explains.  A session whose client
+//    stops reading, or sends faster than its commands run, is not
+//    read or run any further until its backlog drains.
+// block_signals -
+//    Blocks SIGINT and SIGTERM, which the server takes through a
+//    signalfd.  Call it before any other thread is started, so that
+//    every thread inherits the mask.
+// run -
+//    Serves until SIGINT or SIGTERM, then lets the commands being run
+//    finish, closes every connection, and removes the socket.
+
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+#include "file_sys.h"
+#include "workpool.h"
+
+class server_error: public runtime_error {
+   public:
+      explicit server_error (const string& what);
+};
+
+class server {
+   private:
+      struct session;
+      static constexpr size_t backlog_limit {1 << 20};
+      inode_state::tree_ptr tree;
+      string path;
+      int listen_fd {-1};
+      int epoll_fd {-1};
+      int wake_fd {-1};
+      int signal_fd {-1};
+      unordered_map<int,unique_ptr<session>> sessions;
+      work_pool runners;
+      mutex finished_lock;
+      vector<session*> finished;
+      bool stopping {false};
+      [[noreturn]] void fail (const string& what);
+      void watch (int fd, uint32_t events);
+      void rewatch (session& client);
+      void accept_clients();
+      void open_session (session& client);
+      void read_client (session& client);
+      void write_client (session& client);
+      void dispatch (session& client);
+      void run_batch (session& client);
+      void hand_back (session& client);
+      void collect();
+      void service (session& client);
+      void close_client (session& client);
+   public:
+      server (inode_state& state, const string& socket_path,
+              size_t threads);
+      server (const server&) = delete;
+      server& operator= (const server&) = delete;
+      ~server();
+      void run();
+      static void block_signals();
+};
+
+#endif
+
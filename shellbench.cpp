@@ -0,0 +1,345 @@
+// $Id: shellbench.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// shellbench -
+//    The baseline for the shell's own commands.  Trees of four shapes
+//    are generated:  a deep chain, a wide fan-out, a balanced tree,
+//    and a realistic mix with uneven fan-out and file sizes.  On each,
+//    mkdir, make, cd, ls, lsr, cat, rm, and rmr are timed one command
+//    at a time, through execute as a session would run them, with
+//    the output going to memory.  Each scenario is repeated, on a new
+//    tree whenever it changes the tree, and the latencies of all the
+//    repetitions are pooled.  Prints one line per shape and scenario:
+//    commands timed, mean, and percentiles, in nanoseconds, as CSV,
+//    or as JSON with -j.
+//    Options:  -n nodes in each tree (10000), -r repetitions (5),
+//    -s random seed (1), -j JSON.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+#include "commands.h"
+#include "file_sys.h"
+#include "util.h"
+
+using bench_clock = chrono::steady_clock;
+
+// tree_map -
+//    What a generator made:  the absolute path of every directory,
+//    the root first, and of every plain file.
+
+struct tree_map {
+   vector<string> dirs;
+   vector<string> files;
+};
+
+// run_words -
+//    Runs one command line given as words.
+
+void run_words (inode_state& state, initializer_list<string> words) {
+   viewvec views (words.begin(), words.end());
+   execute (state, views);
+}
+
+string child_path (const string& dir, const string& name) {
+   return dir == "/" ? "/" + name : dir + "/" + name;
+}
+
+// add_dir, add_file -
+//    Make one entry in a directory, by its path, and note it.
+
+void add_dir (inode_state& state, tree_map& tree, const string& dir,
+              const string& name) {
+   run_words (state, {"cd", dir});
+   run_words (state, {"mkdir", name});
+   tree.dirs.push_back (child_path (dir, name));
+}
+
+void add_file (inode_state& state, tree_map& tree, const string& dir,
+               const string& name, size_t words) {
+   run_words (state, {"cd", dir});
+   vector<string> line {"make", name};
+   for (size_t word = 0; word < words; ++word) {
+      line.push_back ("word" + to_string (word));
+   }
+   viewvec views (line.begin(), line.end());
+   execute (state, views);
+   tree.files.push_back (child_path (dir, name));
+}
+
+// Generators.  Each makes about nodes entries below the root.
+
+tree_map chain_tree (inode_state& state, size_t nodes, mt19937&) {
+   // Nine files and one directory at each level, so that paths get
+   // long.
+   tree_map tree {{"/"}, {}};
+   string dir = "/";
+   for (size_t level = 0; level * 10 < nodes; ++level) {
+      for (int file = 0; file < 9; ++file) {
+         add_file (state, tree, dir, "f" + to_string (file), 4);
+      }
+      add_dir (state, tree, dir, "d");
+      dir = tree.dirs.back();
+   }
+   return tree;
+}
+
+tree_map wide_tree (inode_state& state, size_t nodes, mt19937&) {
+   // Everything in the root, one directory to every nine files.
+   tree_map tree {{"/"}, {}};
+   for (size_t entry = 0; entry < nodes; ++entry) {
+      string name = "e" + to_string (entry);
+      if (entry % 10 == 0) add_dir (state, tree, "/", name);
+      else add_file (state, tree, "/", name, 4);
+   }
+   return tree;
+}
+
+tree_map balanced_tree (inode_state& state, size_t nodes, mt19937&) {
+   // Eight directories and eight files in every directory, breadth
+   // first, until there are enough.
+   tree_map tree {{"/"}, {}};
+   for (size_t next = 0; tree.dirs.size() + tree.files.size() < nodes;
+        ++next) {
+      string dir = tree.dirs[next];
+      for (int child = 0; child < 8; ++child) {
+         add_dir (state, tree, dir, "d" + to_string (child));
+         add_file (state, tree, dir, "f" + to_string (child), 4);
+      }
+   }
+   return tree;
+}
+
+tree_map mixed_tree (inode_state& state, size_t nodes, mt19937& rng) {
+   // Most directories are small and a few are large; most files are
+   // short and a few are long.  Directories are filled in random
+   // order, so that depth varies.
+   tree_map tree {{"/"}, {}};
+   geometric_distribution<size_t> fan_out (0.15);
+   geometric_distribution<size_t> file_words (0.1);
+   static const char* stems[] {"src", "index", "data", "lib", "test",
+                               "README", "Makefile", "config"};
+   while (tree.dirs.size() + tree.files.size() < nodes) {
+      string dir = tree.dirs[rng() % tree.dirs.size()];
+      size_t files = fan_out (rng);
+      for (size_t file = 0; file < files; ++file) {
+         string name = string (stems[rng() % 8]) + to_string (rng());
+         add_file (state, tree, dir, name, 1 + file_words (rng));
+      }
+      add_dir (state, tree, dir, "dir" + to_string (rng()));
+   }
+   return tree;
+}
+
+using generator_fn = tree_map (*)(inode_state&, size_t, mt19937&);
+
+struct shape {
+   const char* name;
+   generator_fn generate;
+};
+
+const shape shapes[] {
+   {"chain", chain_tree},
+   {"wide", wide_tree},
+   {"balanced", balanced_tree},
+   {"mixed", mixed_tree},
+};
+
+// scenario -
+//    Runs commands on a tree, passing each to time so that only the
+//    command itself is timed.  A scenario that changes the tree is
+//    given a new one on each repetition.
+
+using timer_fn = function<void (initializer_list<string>)>;
+
+struct scenario {
+   const char* name;
+   bool changes;
+   function<void (inode_state&, tree_map&, mt19937&, timer_fn)> run;
+};
+
+const size_t samples {1000};
+
+const scenario scenarios[] {
+   {"mkdir", true, [] (inode_state& state, tree_map& tree,
+                       mt19937& rng, timer_fn time) {
+      for (size_t count = 0; count < samples; ++count) {
+         run_words (state, {"cd", tree.dirs[rng() % tree.dirs.size()]});
+         time ({"mkdir", "new" + to_string (count)});
+      }
+   }},
+   {"make", true, [] (inode_state& state, tree_map& tree,
+                      mt19937& rng, timer_fn time) {
+      for (size_t count = 0; count < samples; ++count) {
+         run_words (state, {"cd", tree.dirs[rng() % tree.dirs.size()]});
+         time ({"make", "new" + to_string (count), "some", "text"});
+      }
+   }},
+   {"cd", false, [] (inode_state&, tree_map& tree, mt19937& rng,
+                     timer_fn time) {
+      for (size_t count = 0; count < samples; ++count) {
+         time ({"cd", tree.dirs[rng() % tree.dirs.size()]});
+      }
+   }},
+   {"ls", false, [] (inode_state&, tree_map& tree, mt19937& rng,
+                     timer_fn time) {
+      for (size_t count = 0; count < samples; ++count) {
+         time ({"ls", tree.dirs[rng() % tree.dirs.size()]});
+      }
+   }},
+   {"lsr", false, [] (inode_state&, tree_map&, mt19937&,
+                      timer_fn time) {
+      time ({"lsr", "/"});
+   }},
+   {"cat", false, [] (inode_state&, tree_map& tree, mt19937& rng,
+                      timer_fn time) {
+      if (tree.files.empty()) return;
+      for (size_t count = 0; count < samples; ++count) {
+         time ({"cat", tree.files[rng() % tree.files.size()]});
+      }
+   }},
+   {"rm", true, [] (inode_state&, tree_map& tree, mt19937& rng,
+                    timer_fn time) {
+      shuffle (tree.files.begin(), tree.files.end(), rng);
+      size_t count = min (samples, tree.files.size());
+      for (size_t file = 0; file < count; ++file) {
+         time ({"rm", tree.files[file]});
+      }
+   }},
+   {"rmr", true, [] (inode_state&, tree_map& tree, mt19937&,
+                     timer_fn time) {
+      // Every subtree of the root, one at a time, then the root.
+      const string& top = tree.dirs.front();
+      vector<string> tops;
+      for (const string& dir: tree.dirs) {
+         if (dir != top and dir.find ('/', 1) == string::npos) {
+            tops.push_back (dir);
+         }
+      }
+      for (const string& dir: tops) time ({"rmr", dir});
+   }},
+};
+
+// percentile -
+//    Nearest rank in sorted latencies.
+
+double percentile (const vector<double>& sorted, double fraction) {
+   if (sorted.empty()) return 0;
+   size_t rank = static_cast<size_t> (fraction * sorted.size());
+   return sorted[min (rank, sorted.size() - 1)];
+}
+
+struct result {
+   string shape;
+   string scenario;
+   vector<double> ns;
+};
+
+void print_csv (const vector<result>& results) {
+   cout << "shape,scenario,count,mean_ns,p50_ns,p90_ns,p99_ns,max_ns"
+        << endl;
+   for (const auto& each: results) {
+      double total = 0;
+      for (double ns: each.ns) total += ns;
+      cout << each.shape << "," << each.scenario << ","
+           << each.ns.size() << ","
+           << (each.ns.empty() ? 0 : total / each.ns.size()) << ","
+           << percentile (each.ns, 0.5) << ","
+           << percentile (each.ns, 0.9) << ","
+           << percentile (each.ns, 0.99) << ","
+           << (each.ns.empty() ? 0 : each.ns.back()) << endl;
+   }
+}
+
+void print_json (const vector<result>& results) {
+   cout << "[" << endl;
+   for (size_t index = 0; index < results.size(); ++index) {
+      const result& each = results[index];
+      double total = 0;
+      for (double ns: each.ns) total += ns;
+      cout << "  {\"shape\": \"" << each.shape << "\", \"scenario\": \""
+           << each.scenario << "\", \"count\": " << each.ns.size()
+           << ", \"mean_ns\": "
+           << (each.ns.empty() ? 0 : total / each.ns.size())
+           << ", \"p50_ns\": " << percentile (each.ns, 0.5)
+           << ", \"p90_ns\": " << percentile (each.ns, 0.9)
+           << ", \"p99_ns\": " << percentile (each.ns, 0.99)
+           << ", \"max_ns\": " << (each.ns.empty() ? 0 : each.ns.back())
+           << "}" << (index + 1 < results.size() ? "," : "") << endl;
+   }
+   cout << "]" << endl;
+}
+
+int main (int argc, char** argv) {
+   size_t nodes = 10000;
+   size_t repetitions = 5;
+   unsigned seed = 1;
+   bool json = false;
+   for (;;) {
+      int option = getopt (argc, argv, "jn:r:s:");
+      if (option == EOF) break;
+      switch (option) {
+         case 'j': json = true; break;
+         case 'n': nodes = stoul (optarg); break;
+         case 'r': repetitions = stoul (optarg); break;
+         case 's': seed = stoul (optarg); break;
+         default:
+            cerr << "Usage: " << argv[0]
+                 << " [-j] [-n nodes] [-r repetitions] [-s seed]"
+                 << endl;
+            return EXIT_FAILURE;
+      }
+   }
+
+   // Commands write to memory, which is emptied between them.
+   output_sink out;
+   ostringstream errors;
+   output_scope scope (out, errors);
+   vector<result> results;
+   for (const shape& form: shapes) {
+      mt19937 rng (seed);
+      auto state = make_unique<inode_state>();
+      tree_map tree = form.generate (*state, nodes, rng);
+      for (const scenario& test: scenarios) {
+         result timed {form.name, test.name, {}};
+         auto time = [&state, &timed, &out] (
+                     initializer_list<string> words) {
+            viewvec views (words.begin(), words.end());
+            auto start = bench_clock::now();
+            execute (*state, views);
+            chrono::duration<double,nano> spent =
+                  bench_clock::now() - start;
+            timed.ns.push_back (spent.count());
+            out.clear();
+         };
+         for (size_t round = 0; round < repetitions; ++round) {
+            if (test.changes and round > 0) {
+               mt19937 again (seed);
+               state = make_unique<inode_state>();
+               tree = form.generate (*state, nodes, again);
+            }
+            test.run (*state, tree, rng, time);
+            out.clear();
+            errors.str ("");
+         }
+         if (test.changes) {
+            mt19937 again (seed);
+            state = make_unique<inode_state>();
+            tree = form.generate (*state, nodes, again);
+         }
+         sort (timed.ns.begin(), timed.ns.end());
+         results.push_back (move (timed));
+      }
+   }
+   if (json) print_json (results); else print_csv (results);
+   return EXIT_SUCCESS;
+}
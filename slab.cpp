@@ -0,0 +1,95 @@
+// $Id: slab.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <iostream>
+
+using namespace std;
+
+#include "debug.h"
+#include "slab.h"
+
+// pools -
+//    Every pool made, for the totals.  Pools are never destroyed, and
+//    some are made during static initialization, so the list is made
+//    on first use and never destroyed either.
+
+static mutex pools_lock;
+
+static vector<const slab_pool*>& pools() {
+   static auto* every = new vector<const slab_pool*>;
+   return *every;
+}
+
+slab_pool::slab_pool (size_t size, size_t align):
+           slot_size (size < sizeof (free_slot) ? sizeof (free_slot)
+                                                : size),
+           slot_align (align < alignof (free_slot) ? alignof (free_slot)
+                                                   : align) {
+   // Round the slot up so every slot in a chunk stays aligned.
+   slot_size = (slot_size + slot_align - 1) / slot_align * slot_align;
+   lock_guard<mutex> guard (pools_lock);
+   pools().push_back (this);
+}
+
+void slab_pool::grow() {
+   char* chunk = static_cast<char*> (::operator new (
+                 next_chunk * slot_size, align_val_t (slot_align)));
+   chunks.push_back (chunk);
+   // Thread the new slots so that they are handed out in address
+   // order, which keeps consecutively created inodes adjacent.
+   for (size_t slot = next_chunk; slot > 0; --slot) {
+      free_slot* item = reinterpret_cast<free_slot*> (
+                        chunk + (slot - 1) * slot_size);
+      item->next = free_list;
+      free_list = item;
+   }
+   capacity_ += next_chunk;
+   DEBUGF ('s', "slot_size = " << slot_size << ", chunk of "
+          << next_chunk << ", capacity = " << capacity_);
+   if (next_chunk < largest_chunk) next_chunk *= 2;
+}
+
+void* slab_pool::allocate() {
+   lock_guard<mutex> guard (lock);
+   if (free_list == nullptr) grow();
+   free_slot* item = free_list;
+   free_list = item->next;
+   ++live_;
+   return item;
+}
+
+void slab_pool::deallocate (void* slot) {
+   lock_guard<mutex> guard (lock);
+   free_slot* item = static_cast<free_slot*> (slot);
+   item->next = free_list;
+   free_list = item;
+   --live_;
+}
+
+size_t slab_pool::live() const {
+   lock_guard<mutex> guard (lock);
+   return live_;
+}
+
+size_t slab_pool::capacity() const {
+   lock_guard<mutex> guard (lock);
+   return capacity_;
+}
+
+
+size_t slab_pool::held_bytes() {
+   lock_guard<mutex> guard (pools_lock);
+   size_t bytes = 0;
+   for (const slab_pool* pool: pools()) {
+      bytes += pool->capacity() * pool->slot_size;
+   }
+   return bytes;
+}
+
+size_t slab_pool::live_bytes() {
+   lock_guard<mutex> guard (pools_lock);
+   size_t bytes = 0;
+   for (const slab_pool* pool: pools()) {
+      bytes += pool->live() * pool->slot_size;
+   }
+   return bytes;
+}
@@ -0,0 +1,93 @@
+// $Id: slab.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// slab_pool -
+//    Fixed size object pool.  Memory is taken from the heap in
+//    chunks of geometrically increasing size, carved into slots of
+//    one size, and freed slots are threaded onto a free list for
+//    reuse.  Chunks are never returned to the system:  an inode freed
+//    by rmr, once the reclaimer is done with it, only goes back on
+//    its pool's free list, so a tree that shrinks keeps its slots for
+//    the next burst of allocations, and the process does not shrink.
+//    A mutex guards the free list, since subtrees are freed by the
+//    reclaimer thread while the shell goes on allocating.
+// held_bytes, live_bytes -
+//    The bytes in the chunks of every pool, and in the slots of them
+//    handed out.  reclaim prints both, so what is kept free in the
+//    pools is seen as the difference.
+// slab_allocator -
+//    Standard allocator over one slab_pool per object type, used with
+//    allocate_shared so that an inode, its contents, and the
+//    shared_ptr control block all live in a single slot.
+
+#ifndef __SLAB_H__
+#define __SLAB_H__
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+using namespace std;
+
+class slab_pool {
+   private:
+      struct free_slot { free_slot* next; };
+      static constexpr size_t first_chunk {32};
+      static constexpr size_t largest_chunk {8192};
+      size_t slot_size;
+      size_t slot_align;
+      size_t next_chunk {first_chunk};
+      size_t live_ {0};
+      size_t capacity_ {0};
+      free_slot* free_list {nullptr};
+      vector<void*> chunks;
+      mutable mutex lock;
+      void grow();
+   public:
+      slab_pool (size_t size, size_t align);
+      slab_pool (const slab_pool&) = delete;
+      slab_pool& operator= (const slab_pool&) = delete;
+      void* allocate();
+      void deallocate (void* slot);
+      size_t live() const;
+      size_t capacity() const;
+      static size_t held_bytes();
+      static size_t live_bytes();
+};
+
+template <typename item_t>
+class slab_allocator {
+   public:
+      using value_type = item_t;
+      slab_allocator() = default;
+      template <typename other_t>
+      slab_allocator (const slab_allocator<other_t>&) {}
+      static slab_pool& pool() {
+         // Never destroyed, so objects freed during static
+         // destruction still have a pool to go back to.
+         static slab_pool* pool_ =
+                new slab_pool (sizeof (item_t), alignof (item_t));
+         return *pool_;
+      }
+      item_t* allocate (size_t count) {
+         if (count != 1) {
+            return static_cast<item_t*> (
+                   ::operator new (count * sizeof (item_t)));
+         }
+         return static_cast<item_t*> (pool().allocate());
+      }
+      void deallocate (item_t* item, size_t count) {
+         if (count != 1) ::operator delete (item);
+                    else pool().deallocate (item);
+      }
+      template <typename other_t>
+      bool operator== (const slab_allocator<other_t>&) const {
+         return true;
+      }
+      template <typename other_t>
+      bool operator!= (const slab_allocator<other_t>&) const {
+         return false;
+      }
+};
+
+#endif
+
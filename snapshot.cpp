@@ -0,0 +1,199 @@
+// $Id: snapshot.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+#include "content.h"
+#include "debug.h"
+#include "snapshot.h"
+
+static constexpr char snapshot_magic[8] = "YSHSNAP";
+static constexpr uint32_t snapshot_version {1};
+
+snapshot_error::snapshot_error (const string& what):
+                runtime_error (what) {
+}
+
+// fits -
+//    Whether count items of the given size, starting at offset, lie
+//    within a file of the given length, without overflowing.
+
+static bool fits (uint64_t offset, uint64_t count, size_t item,
+                  uint64_t length) {
+   return offset <= length and count <= (length - offset) / item;
+}
+
+snapshot_image::snapshot_image (const string& filename):
+                file (filename) {
+   uint64_t length = file.size();
+   if (length < sizeof (snapshot_header)) {
+      throw snapshot_error (filename + ": not a snapshot");
+   }
+   header = reinterpret_cast<const snapshot_header*> (at (0));
+   if (memcmp (header->magic, snapshot_magic, sizeof snapshot_magic)) {
+      throw snapshot_error (filename + ": not a snapshot");
+   }
+   if (header->version != snapshot_version) {
+      throw snapshot_error (filename + ": snapshot version "
+                            + to_string (header->version));
+   }
+   if (header->inodes == 0
+    or not fits (header->inode_offset, header->inodes,
+                 sizeof (snapshot_inode), length)
+    or not fits (header->child_offset, header->children,
+                 sizeof (uint32_t), length)
+    or not fits (header->name_offset, header->names,
+                 sizeof (uint64_t), length)
+    or not fits (header->payload_offset, header->payload_size, 1,
+                 length)
+    or header->inode_offset % alignof (snapshot_inode) != 0
+    or header->child_offset % alignof (uint32_t) != 0
+    or header->name_offset % alignof (uint64_t) != 0
+    or header->payload_offset % alignof (uint32_t) != 0) {
+      throw snapshot_error (filename + ": snapshot is truncated");
+   }
+   DEBUGF ('p', filename << ": " << header->inodes << " inodes, "
+          << header->names << " names");
+}
+
+const snapshot_inode& snapshot_image::inode (uint64_t index) const {
+   if (index >= header->inodes) {
+      throw snapshot_error ("snapshot inode " + to_string (index)
+                            + " out of range");
+   }
+   return reinterpret_cast<const snapshot_inode*> (
+          at (header->inode_offset))[index];
+}
+
+const uint32_t* snapshot_image::children (
+                const snapshot_inode& dir) const {
+   if (not fits (dir.offset, dir.count, 1, header->children)) {
+      throw snapshot_error ("snapshot directory "
+                            + to_string (dir.inode_nr)
+                            + " children out of range");
+   }
+   return reinterpret_cast<const uint32_t*> (
+          at (header->child_offset)) + dir.offset;
+}
+
+string_view snapshot_image::name (uint32_t index) const {
+   if (index >= header->names) {
+      throw snapshot_error ("snapshot name " + to_string (index)
+                            + " out of range");
+   }
+   uint64_t offset = reinterpret_cast<const uint64_t*> (
+                     at (header->name_offset))[index];
+   uint32_t length = 0;
+   if (fits (offset, sizeof length, 1, file.size())) {
+      memcpy (&length, at (offset), sizeof length);
+      offset += sizeof length;
+      if (fits (offset, length, 1, file.size())) {
+         return {at (offset), length};
+      }
+   }
+   throw snapshot_error ("snapshot name " + to_string (index)
+                         + " is truncated");
+}
+
+const char* snapshot_image::payload (
+            const snapshot_inode& plain) const {
+   uint64_t size = file_content::image_size (plain.length, plain.count);
+   if (plain.offset % alignof (uint32_t) != 0
+    or not fits (plain.offset, size, 1, header->payload_size)) {
+      throw snapshot_error ("snapshot file "
+                            + to_string (plain.inode_nr)
+                            + " out of range");
+   }
+   return at (header->payload_offset + plain.offset);
+}
+
+uint32_t snapshot_writer::add_inode() {
+   inodes.push_back (snapshot_inode {});
+   return inodes.size() - 1;
+}
+
+uint32_t snapshot_writer::name (name_id id) {
+   auto [itor, added] = name_index.emplace (id, names.size());
+   if (added) names.push_back (id);
+   return itor->second;
+}
+
+// write_section -
+//    Writes one section after padding the file to eight bytes, and
+//    returns the offset at which it starts.
+
+static uint64_t write_section (ofstream& out, const void* data,
+                               size_t size) {
+   static const char zeros[8] {};
+   uint64_t offset = out.tellp();
+   out.write (zeros, (8 - offset % 8) % 8);
+   offset = out.tellp();
+   out.write (static_cast<const char*> (data), size);
+   return offset;
+}
+
+void snapshot_writer::write (const string& filename,
+                             uint32_t next_inode_nr) {
+   // The image is written beside the file it replaces, so the old
+   // one stays whole, and mapped, until the new one is on disk.
+   string temp = filename + ".tmp";
+   ofstream out (temp, ios::binary | ios::trunc);
+   if (not out) {
+      throw snapshot_error (temp + ": " + strerror (errno));
+   }
+   snapshot_header header {};
+   memcpy (header.magic, snapshot_magic, sizeof snapshot_magic);
+   header.version = snapshot_version;
+   header.next_inode_nr = next_inode_nr;
+   header.inodes = inodes.size();
+   header.children = children.size();
+   header.names = names.size();
+   header.payload_size = payload_.size();
+   out.write (reinterpret_cast<const char*> (&header), sizeof header);
+
+   header.inode_offset = write_section (out, inodes.data(),
+                         inodes.size() * sizeof (snapshot_inode));
+   header.child_offset = write_section (out, children.data(),
+                         children.size() * sizeof (uint32_t));
+
+   // The name strings follow the offset table that points at them.
+   string text;
+   vector<uint64_t> offsets;
+   uint64_t base = out.tellp();
+   base += (8 - base % 8) % 8 + names.size() * sizeof (uint64_t);
+   for (name_id id: names) {
+      const string& name = name_table::name (id);
+      uint32_t length = name.size();
+      offsets.push_back (base + text.size());
+      text.append (reinterpret_cast<const char*> (&length),
+                   sizeof length);
+      text.append (name);
+   }
+   header.name_offset = write_section (out, offsets.data(),
+                        offsets.size() * sizeof (uint64_t));
+   out.write (text.data(), text.size());
+   header.payload_offset = write_section (out, payload_.data(),
+                                          payload_.size());
+
+   out.seekp (0);
+   out.write (reinterpret_cast<const char*> (&header), sizeof header);
+   out.close();
+   if (out.fail()) {
+      remove (temp.c_str());
+      throw snapshot_error (filename + ": write failed");
+   }
+   if (not replace_file (temp, filename)) {
+      int error = errno;
+      remove (temp.c_str());
+      throw snapshot_error (filename + ": " + strerror (error));
+   }
+   DEBUGF ('p', filename << ": " << inodes.size() << " inodes, "
+          << names.size() << " names, " << payload_.size()
+          << " payload bytes");
+}
+
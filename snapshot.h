@@ -0,0 +1,110 @@
+// $Id: snapshot.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// snapshot -
+//    The binary image of a tree, written by save and read by load.
+//    Numbers are in host byte order, and every section starts on an
+//    eight byte boundary.  In order, the file holds:
+//       snapshot_header
+//       inode table:  one snapshot_inode per inode, the root first
+//       child table:  uint32_t inode indexes, each directory's
+//                     children together and in name order
+//       name table:   uint64_t offsets, each to a uint32_t length
+//                     followed by that many bytes of name
+//       payload:      the text and word offsets of each plain file,
+//                     laid out as file_content keeps them
+// snapshot_inode -
+//    For a directory, offset and count locate its children in the
+//    child table, and files, dirs, and bytes are its subtree totals.
+//    For a plain file, offset and length locate its text in the
+//    payload, and count is its number of words.
+// snapshot_image -
+//    A snapshot mapped read-only into memory.  The header and the
+//    section bounds are checked when it is opened.  Everything else
+//    is checked as it is read, so that opening costs the same
+//    whatever the size of the tree.  Bad images throw snapshot_error.
+// snapshot_writer -
+//    Collects the sections of an image, then writes them out to a
+//    new file, which replaces the old one once it is on disk.
+
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+#include "mapfile.h"
+#include "names.h"
+
+class snapshot_error: public runtime_error {
+   public:
+      explicit snapshot_error (const string& what);
+};
+
+struct snapshot_header {
+   char magic[8];
+   uint32_t version;
+   uint32_t next_inode_nr;
+   uint64_t inodes;
+   uint64_t inode_offset;
+   uint64_t children;
+   uint64_t child_offset;
+   uint64_t names;
+   uint64_t name_offset;
+   uint64_t payload_size;
+   uint64_t payload_offset;
+};
+
+enum class snapshot_type: uint32_t {PLAIN, DIRECTORY};
+
+struct snapshot_inode {
+   uint32_t inode_nr;
+   snapshot_type type;
+   uint32_t name;
+   uint32_t count;
+   uint64_t offset;
+   uint64_t length;
+   uint64_t files;
+   uint64_t dirs;
+   uint64_t bytes;
+};
+
+class snapshot_image {
+   private:
+      mapped_file file;
+      const snapshot_header* header {nullptr};
+      const char* at (uint64_t offset) const {
+         return file.view().data() + offset;
+      }
+   public:
+      explicit snapshot_image (const string& filename);
+      uint32_t next_inode_nr() const { return header->next_inode_nr; }
+      const snapshot_inode& inode (uint64_t index) const;
+      const uint32_t* children (const snapshot_inode& dir) const;
+      string_view name (uint32_t index) const;
+      const char* payload (const snapshot_inode& file) const;
+};
+
+class snapshot_writer {
+   private:
+      vector<snapshot_inode> inodes;
+      vector<uint32_t> children;
+      vector<name_id> names;
+      unordered_map<name_id,uint32_t> name_index;
+      string payload_;
+   public:
+      uint32_t add_inode();
+      snapshot_inode& inode (uint32_t index) { return inodes[index]; }
+      uint32_t name (name_id id);
+      void add_child (uint32_t index) { children.push_back (index); }
+      size_t child_count() const { return children.size(); }
+      string& payload() { return payload_; }
+      void write (const string& filename, uint32_t next_inode_nr);
+};
+
+#endif
+
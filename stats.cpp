@@ -0,0 +1,291 @@
+// $Id: stats.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#include "stats.h"
+
+struct stats::histogram {
+   atomic<uint64_t> buckets[bucket_count] {};
+   atomic<uint64_t> calls {0};
+   atomic<uint64_t> ticks {0};
+   atomic<uint64_t> longest {0};
+};
+
+struct stats::totals {
+   struct command {
+      string_view name;
+      uint64_t calls {0};
+      uint64_t ticks {0};
+      uint64_t longest {0};
+      vector<uint64_t> buckets;
+   };
+   uint64_t counts[counter_count] {};
+   vector<command> commands {max_commands};
+   void merge (const thread_block& block);
+};
+
+// thread_block -
+//    What one thread has counted.  Only the thread writes to it;
+//    anyone holding the registry lock may read it.
+
+struct stats::thread_block {
+   atomic<uint64_t> counts[counter_count] {};
+   atomic<histogram*> commands[max_commands] {};
+   thread_block();
+   ~thread_block();
+};
+
+// registry -
+//    Every live thread_block, what ended threads counted, and the
+//    name of each command.  Never destroyed, since threads and
+//    destructors of other statics may still count at exit.
+
+struct stats::registry {
+   mutex lock;
+   vector<thread_block*> live;
+   totals retired;
+   string_view names[max_commands];
+};
+
+stats::registry& stats::shared() {
+   static registry& only = *new registry;
+   return only;
+}
+
+struct stats::summary {
+   string_view name;
+   uint64_t calls;
+   uint64_t mean;
+   uint64_t p50;
+   uint64_t p99;
+   uint64_t p999;
+   uint64_t longest;
+};
+
+namespace {
+   // Set once a thread's block is gone.  A plain bool, so that it
+   // can be read at any time, even during the thread's exit.
+   thread_local bool block_ended = false;
+
+   // Where ticks are measured from, to convert them to nanoseconds.
+   const uint64_t start_ticks = stats::now();
+   const auto start_time = chrono::steady_clock::now();
+
+   const char* const counter_names[stats::counter_count] {
+      "inodes_made", "inodes_freed", "lookups", "lookup_hits",
+      "bytes_written",
+   };
+}
+
+void stats::totals::merge (const thread_block& block) {
+   for (size_t index = 0; index < counter_count; ++index) {
+      counts[index] += block.counts[index].load (memory_order_relaxed);
+   }
+   for (size_t id = 0; id < max_commands; ++id) {
+      const histogram* hist =
+            block.commands[id].load (memory_order_acquire);
+      if (hist == nullptr) continue;
+      command& into = commands[id];
+      if (into.buckets.empty()) into.buckets.resize (bucket_count);
+      for (size_t index = 0; index < bucket_count; ++index) {
+         into.buckets[index] +=
+               hist->buckets[index].load (memory_order_relaxed);
+      }
+      into.calls += hist->calls.load (memory_order_relaxed);
+      into.ticks += hist->ticks.load (memory_order_relaxed);
+      into.longest = max (into.longest,
+                          hist->longest.load (memory_order_relaxed));
+   }
+}
+
+stats::thread_block::thread_block() {
+   lock_guard<mutex> guard (shared().lock);
+   shared().live.push_back (this);
+}
+
+stats::thread_block::~thread_block() {
+   {
+      lock_guard<mutex> guard (shared().lock);
+      auto& live = shared().live;
+      live.erase (find (live.begin(), live.end(), this));
+      shared().retired.merge (*this);
+   }
+   for (auto& hist: commands) delete hist.load();
+   block_ended = true;
+}
+
+stats::thread_block* stats::mine() {
+   if (block_ended) return nullptr;
+   thread_local thread_block block;
+   return &block;
+}
+
+stats::histogram& stats::make_histogram (thread_block& block,
+                                         size_t id, string_view name) {
+   lock_guard<mutex> guard (shared().lock);
+   shared().names[id] = name;
+   histogram* hist = new histogram();
+   block.commands[id].store (hist, memory_order_release);
+   return *hist;
+}
+
+// bucket -
+//    Values below 32 have a bucket each.  Above that, each power of
+//    two is split into 32 buckets by the five bits below the top one.
+
+size_t stats::bucket (uint64_t ticks) {
+   constexpr uint64_t linear = uint64_t (1) << sub_bits;
+   if (ticks < linear) return ticks;
+   ticks = min (ticks, (uint64_t (1) << top_bits) - 1);
+   unsigned exponent = 63 - __builtin_clzll (ticks);
+   unsigned shift = exponent - sub_bits;
+   return ((shift + 1) << sub_bits) + (ticks >> shift) - linear;
+}
+
+// bucket_value -
+//    The middle of the values that fall in a bucket.
+
+uint64_t stats::bucket_value (size_t index) {
+   constexpr uint64_t linear = uint64_t (1) << sub_bits;
+   if (index < linear) return index;
+   unsigned shift = (index >> sub_bits) - 1;
+   uint64_t low = ((index & (linear - 1)) + linear) << shift;
+   return low + ((uint64_t (1) << shift) >> 1);
+}
+
+void stats::record (size_t id, string_view name, uint64_t ticks) {
+   if (id >= max_commands) return;
+   thread_block* block = mine();
+   if (block == nullptr) return;
+   histogram* hist = block->commands[id].load (memory_order_relaxed);
+   if (hist == nullptr) hist = &make_histogram (*block, id, name);
+   add (hist->buckets[bucket (ticks)], 1);
+   add (hist->calls, 1);
+   add (hist->ticks, ticks);
+   if (ticks > hist->longest.load (memory_order_relaxed)) {
+      hist->longest.store (ticks, memory_order_relaxed);
+   }
+}
+
+void stats::count (counter which, uint64_t amount) {
+   size_t index = static_cast<size_t> (which);
+   thread_block* block = mine();
+   if (block != nullptr) {
+      add (block->counts[index], amount);
+   }else {
+      lock_guard<mutex> guard (shared().lock);
+      shared().retired.counts[index] += amount;
+   }
+}
+
+stats::totals stats::gather() {
+   lock_guard<mutex> guard (shared().lock);
+   totals all = shared().retired;
+   for (const thread_block* block: shared().live) all.merge (*block);
+   for (size_t id = 0; id < max_commands; ++id) {
+      all.commands[id].name = shared().names[id];
+   }
+   return all;
+}
+
+// ns_per_tick -
+//    Compares the ticks and the time since the program started,
+//    after waiting, if need be, for enough time to have passed that
+//    the ratio is good to a fraction of a percent.
+
+double stats::ns_per_tick() {
+#if defined (__x86_64__)
+   constexpr chrono::milliseconds enough {20};
+   auto elapsed = chrono::steady_clock::now() - start_time;
+   if (elapsed < enough) this_thread::sleep_for (enough - elapsed);
+   uint64_t ticks = now() - start_ticks;
+   chrono::duration<double,nano> spent =
+         chrono::steady_clock::now() - start_time;
+   return ticks == 0 ? 1 : spent.count() / ticks;
+#else
+   return 1;
+#endif
+}
+
+// summarize -
+//    Each command that has run, by name.  A percentile is the
+//    bucket holding the value of that rank, but never more than the
+//    longest time seen.
+
+vector<stats::summary> stats::summarize (const totals& all) {
+   double scale = ns_per_tick();
+   auto ns = [scale] (uint64_t ticks) -> uint64_t {
+      return llround (ticks * scale);
+   };
+   vector<summary> result;
+   for (const auto& each: all.commands) {
+      if (each.calls == 0) continue;
+      auto percentile = [&each] (double fraction) {
+         uint64_t rank = ceil (fraction * each.calls);
+         uint64_t seen = 0;
+         for (size_t index = 0; index < each.buckets.size(); ++index) {
+            seen += each.buckets[index];
+            if (seen >= rank) {
+               return min (bucket_value (index), each.longest);
+            }
+         }
+         return each.longest;
+      };
+      result.push_back ({each.name, each.calls,
+                         ns (each.ticks / each.calls),
+                         ns (percentile (0.5)), ns (percentile (0.99)),
+                         ns (percentile (0.999)), ns (each.longest)});
+   }
+   sort (result.begin(), result.end(),
+         [] (const summary& left, const summary& right) {
+            return left.name < right.name;
+         });
+   return result;
+}
+
+void stats::report (output_sink& out) {
+   totals all = gather();
+   out << "     calls   mean_ns    p50_ns    p99_ns   p999_ns"
+       << "    max_ns  command\n";
+   for (const auto& each: summarize (all)) {
+      out << column (each.calls, 10) << column (each.mean, 10)
+          << column (each.p50, 10) << column (each.p99, 10)
+          << column (each.p999, 10) << column (each.longest, 10)
+          << "  " << each.name << '\n';
+   }
+   for (size_t index = 0; index < counter_count; ++index) {
+      out << column (all.counts[index], 10) << "  "
+          << counter_names[index] << '\n';
+   }
+}
+
+string stats::json() {
+   totals all = gather();
+   ostringstream out;
+   out << "{\"commands\": {";
+   const char* comma = "";
+   for (const auto& each: summarize (all)) {
+      out << comma << "\n  \"" << each.name << "\": {\"calls\": "
+          << each.calls << ", \"mean_ns\": " << each.mean
+          << ", \"p50_ns\": " << each.p50
+          << ", \"p99_ns\": " << each.p99
+          << ", \"p999_ns\": " << each.p999
+          << ", \"max_ns\": " << each.longest << "}";
+      comma = ",";
+   }
+   out << "},\n\"counters\": {";
+   for (size_t index = 0; index < counter_count; ++index) {
+      out << (index == 0 ? "" : ",") << "\n  \""
+          << counter_names[index] << "\": " << all.counts[index];
+   }
+   out << "}}\n";
+   return out.str();
+}
+
@@ -0,0 +1,115 @@
+// $Id: stats.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// stats -
+//    Always on measurements of the shell:  how long each command
+//    takes, and counts of what goes on inside.  Every thread keeps
+//    its own, so recording one takes no lock and does no
+//    read-modify-write:  the thread adds to its own counters with a
+//    plain load and store of relaxed atomics, which another thread
+//    may read at any time.  A report sums the threads still running
+//    and what those that have ended left behind.
+// now -
+//    A monotonic tick count.  On x86-64 it is the time stamp counter,
+//    which costs a few nanoseconds to read and runs at a constant
+//    rate on any processor of the last decade; it is converted to
+//    nanoseconds only when reported, against steady_clock.
+//    Elsewhere it is steady_clock in nanoseconds.
+// ns_per_tick -
+//    What one tick is in nanoseconds.  The first call may wait a few
+//    milliseconds to measure it.
+// record -
+//    Adds one run of the command with the given id and name to its
+//    histogram.  Histograms are log-linear, in the manner of HDR
+//    histograms:  each power of two is split into 32 buckets, so a
+//    percentile is within about 3% of the true value.  The name must
+//    outlive the program, as command names do.
+// count -
+//    Adds to one of the counters.
+// report, json -
+//    For each command that has run:  how many times, the mean, the
+//    50th, 99th and 99.9th percentiles, and the longest time, in
+//    nanoseconds; then each counter.  As a table, or as JSON.
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+#if defined (__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include "util.h"
+
+enum class counter: unsigned {
+   INODES_MADE, INODES_FREED, LOOKUPS, LOOKUP_HITS, BYTES_WRITTEN,
+};
+
+class stats {
+   public:
+      static constexpr size_t max_commands {128};
+      static constexpr size_t counter_count {5};
+   private:
+      static constexpr unsigned sub_bits {5};
+      static constexpr unsigned top_bits {48};
+      static constexpr size_t bucket_count {
+                              (top_bits - sub_bits + 1) << sub_bits};
+      struct histogram;
+      struct thread_block;
+      struct totals;
+      struct registry;
+      struct summary;
+      static registry& shared();
+      static thread_block* mine();
+      static histogram& make_histogram (thread_block& block, size_t id,
+                                        string_view name);
+      static void add (atomic<uint64_t>& to, uint64_t amount) {
+         to.store (to.load (memory_order_relaxed) + amount,
+                   memory_order_relaxed);
+      }
+      static size_t bucket (uint64_t ticks);
+      static uint64_t bucket_value (size_t index);
+      static totals gather();
+      static vector<summary> summarize (const totals& all);
+   public:
+      static uint64_t now() {
+#if defined (__x86_64__)
+         return __rdtsc();
+#else
+         return chrono::duration_cast<chrono::nanoseconds> (
+                chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+      }
+      static double ns_per_tick();
+      static void record (size_t id, string_view name, uint64_t ticks);
+      static void count (counter which, uint64_t amount = 1);
+      static void report (output_sink& out);
+      static string json();
+};
+
+// command_timer -
+//    Records the time from its making to its end under a command.
+
+class command_timer {
+   private:
+      size_t id;
+      string_view name;
+      uint64_t start;
+   public:
+      command_timer (size_t id_, string_view name_):
+                     id (id_), name (name_), start (stats::now()) {}
+      ~command_timer() {
+         stats::record (id, name, stats::now() - start);
+      }
+      command_timer (const command_timer&) = delete;
+      command_timer& operator= (const command_timer&) = delete;
+};
+
+#endif
+
@@ -0,0 +1,163 @@
+// $Id: trace.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+#include "stats.h"
+#include "trace.h"
+
+// ring -
+//    The last events of one thread.  Event n is in slot n modulo the
+//    size, and head is the number of the next.  Only the owner writes
+//    to it, and it is never freed, so a dump may read it at any time.
+//    Events before floor have been cleared.
+
+struct trace::ring {
+   static constexpr size_t size {1 << 12};
+   atomic<uint64_t> slots[size][4] {};
+   atomic<uint64_t> head {0};
+   atomic<uint64_t> floor {0};
+   bool owned {true};   // under the registry lock
+};
+
+// registry -
+//    Every ring and every tracepoint that has been reached.  Never
+//    destroyed, since threads may still trace at exit.
+
+struct trace::registry {
+   mutex lock;
+   vector<unique_ptr<ring>> rings;
+   vector<const tracepoint*> points;
+};
+
+thread_local trace::holder trace::current;
+
+trace::registry& trace::shared() {
+   static registry& only = *new registry;
+   return only;
+}
+
+tracepoint::tracepoint (char category_, const char* what_,
+                        const char* file_, int line_):
+            category (category_), what (what_), file (file_),
+            line (line_) {
+   auto& shared = trace::shared();
+   lock_guard<mutex> guard (shared.lock);
+   id = shared.points.size();
+   shared.points.push_back (this);
+}
+
+trace::holder::~holder() {
+   ended = true;
+   if (held == nullptr) return;
+   lock_guard<mutex> guard (shared().lock);
+   held->owned = false;
+}
+
+trace::ring* trace::mine() {
+   if (current.held != nullptr or current.ended) return current.held;
+   lock_guard<mutex> guard (shared().lock);
+   for (auto& each: shared().rings) {
+      if (not each->owned) {
+         each->owned = true;
+         return current.held = each.get();
+      }
+   }
+   shared().rings.push_back (make_unique<ring>());
+   return current.held = shared().rings.back().get();
+}
+
+// write -
+//    The release fence keeps a dump that sees any part of this event
+//    from missing the head that says the slot is being reused.
+
+void trace::write (const tracepoint& point, uint64_t count,
+                   uint64_t first, uint64_t second) {
+   ring* events = mine();
+   if (events == nullptr) return;
+   uint64_t number = events->head.load (memory_order_relaxed);
+   atomic_thread_fence (memory_order_release);
+   auto& slot = events->slots[number & (ring::size - 1)];
+   slot[0].store (stats::now(), memory_order_relaxed);
+   slot[1].store (point.id | count << 32, memory_order_relaxed);
+   slot[2].store (first, memory_order_relaxed);
+   slot[3].store (second, memory_order_relaxed);
+   events->head.store (number + 1, memory_order_release);
+}
+
+void trace::clear() {
+   lock_guard<mutex> guard (shared().lock);
+   for (auto& each: shared().rings) {
+      each->floor.store (each->head.load (memory_order_acquire),
+                         memory_order_relaxed);
+   }
+}
+
+namespace {
+   struct event {
+      uint64_t ticks;
+      size_t ring;
+      uint64_t words[3];
+   };
+}
+
+// dump -
+//    Each ring is copied while its owner may still be writing, then
+//    its head read again.  Any slot the owner may have begun to
+//    write over by then is left out.
+
+void trace::dump (output_sink& out) {
+   vector<event> events;
+   vector<const tracepoint*> points;
+   {
+      lock_guard<mutex> guard (shared().lock);
+      points = shared().points;
+      for (size_t index = 0; index < shared().rings.size(); ++index) {
+         const ring& each = *shared().rings[index];
+         uint64_t head = each.head.load (memory_order_acquire);
+         uint64_t first = head > ring::size ? head - ring::size : 0;
+         first = max (first, each.floor.load (memory_order_relaxed));
+         size_t copied = events.size();
+         for (uint64_t number = first; number < head; ++number) {
+            const auto& slot = each.slots[number & (ring::size - 1)];
+            events.push_back ({slot[0].load (memory_order_relaxed),
+                               index,
+                               {slot[1].load (memory_order_relaxed),
+                                slot[2].load (memory_order_relaxed),
+                                slot[3].load (memory_order_relaxed)}});
+         }
+         atomic_thread_fence (memory_order_acquire);
+         uint64_t now = each.head.load (memory_order_relaxed);
+         uint64_t overwritten = now + 1 > ring::size
+                              ? now + 1 - ring::size : 0;
+         if (overwritten > first) {
+            size_t lost = min (overwritten - first, head - first);
+            events.erase (events.begin() + copied,
+                          events.begin() + copied + lost);
+         }
+      }
+   }
+   if (events.empty()) return;
+   sort (events.begin(), events.end(),
+         [] (const event& left, const event& right) {
+            return left.ticks < right.ticks;
+         });
+   double scale = stats::ns_per_tick();
+   uint64_t start = events.front().ticks;
+   for (const auto& each: events) {
+      const tracepoint& point = *points[each.words[0] & 0xFFFFFFFF];
+      out << column (llround ((each.ticks - start) * scale), 12)
+          << column (each.ring, 4) << "  " << point.category << "  "
+          << point.what;
+      for (uint64_t arg = 0; arg < each.words[0] >> 32; ++arg) {
+         out << ' ' << each.words[1 + arg];
+      }
+      out << "  " << point.file << "[" << point.line << "]\n";
+   }
+}
+
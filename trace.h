@@ -0,0 +1,107 @@
+// $Id: trace.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// trace -
+//    Tracepoints cheap enough to leave in a run being measured.
+//    Which categories are traced is fixed when the shell is built:
+//    a tracepoint whose category is not in TRACE_CATEGORIES compiles
+//    to nothing, not even a test of a flag, and its arguments are
+//    never evaluated.  The categories are characters, as for DEBUGF,
+//    and '@' means all of them.  Build with, for instance,
+//       make clean; make TRACE=yi
+//    A tracepoint that is compiled in records an event of 32 bytes:
+//    the time stamp counter, which tracepoint, and up to two numbers.
+//    Each thread writes its events to a ring of its own, with relaxed
+//    atomic stores and no lock or read-modify-write, overwriting the
+//    oldest once the ring is full.  Nothing is formatted until the
+//    events are dumped.
+// TRACE -
+//    TRACE (category, what, args...) records an event.  What is a
+//    string literal naming the event, and there may be no more than
+//    two args, each an integer, enum, or pointer.
+// dump -
+//    Prints every event still held, from all threads, oldest first:
+//    nanoseconds since the first, the thread's ring, the category,
+//    what happened and its args, and the place of the tracepoint.
+//    A ring given up by a thread that has ended is taken by the next
+//    thread to start, so a ring's events may span threads.
+// clear -
+//    Forgets every event recorded so far.
+// Tracepoints in use, by category:
+//    g grace periods, h snapshots, i inodes, j journal commits,
+//    l path lookups, r reclaimed subtrees, v sessions, y commands.
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+using namespace std;
+
+#include "util.h"
+
+#ifndef TRACE_CATEGORIES
+#define TRACE_CATEGORIES ""
+#endif
+
+struct tracepoint {
+   char category;
+   const char* what;
+   const char* file;
+   int line;
+   uint32_t id;
+   tracepoint (char category_, const char* what_, const char* file_,
+               int line_);
+};
+
+class trace {
+   friend struct tracepoint;
+   private:
+      struct ring;
+      struct registry;
+      struct holder {
+         ring* held {nullptr};
+         bool ended {false};
+         ~holder();
+      };
+      static thread_local holder current;
+      static registry& shared();
+      static ring* mine();
+      static void write (const tracepoint& point, uint64_t count,
+                         uint64_t first, uint64_t second);
+      template <typename arg_t>
+      static uint64_t word (arg_t arg) {
+         if constexpr (is_pointer_v<arg_t>) {
+            return reinterpret_cast<uintptr_t> (arg);
+         }else {
+            return static_cast<uint64_t> (arg);
+         }
+      }
+   public:
+      static constexpr bool compiled (char category) {
+         for (char each: string_view (TRACE_CATEGORIES)) {
+            if (each == category or each == '@') return true;
+         }
+         return false;
+      }
+      template <typename... args_t>
+      static void record (const tracepoint& point, args_t... args) {
+         static_assert (sizeof... (args) <= 2, "at most two args");
+         uint64_t words[] {word (args)..., 0, 0};
+         write (point, sizeof... (args), words[0], words[1]);
+      }
+      static void dump (output_sink& out);
+      static void clear();
+};
+
+#define TRACE(CATEGORY,WHAT,...) { \
+           if constexpr (trace::compiled (CATEGORY)) { \
+              static const tracepoint point_ {CATEGORY, WHAT, \
+                                              __FILE__, __LINE__}; \
+              trace::record (point_, ##__VA_ARGS__); \
+           } \
+        }
+
+#endif
+
@@ -1,12 +1,20 @@
 // $Id: util.cpp,v 1.14 2019-10-08 14:01:38-07 - - $
 
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
 #include <cstdlib>
+#include <cstring>
 #include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
 #include "util.h"
 #include "debug.h"
+#include "stats.h"
 
 bool want_echo() {
    constexpr int CIN_FD {0};
@@ -19,7 +27,7 @@ bool want_echo() {
 }
 
 string exec::execname_; // Must be initialized from main().
-int exec::status_ = EXIT_SUCCESS;
+atomic<int> exec::status_ {EXIT_SUCCESS};
 
 string basename (const string &arg) { 
    return arg.substr (arg.find_last_of ('/') + 1);
@@ -33,7 +41,9 @@ void exec::execname (const string& argv0) {
 }
 
 void exec::status (int status) {
-   if (status_ < status) status_ = status;
+   int old = status_;
+   while (old < status
+          and not status_.compare_exchange_weak (old, status)) {}
 }
 
 
@@ -53,9 +63,191 @@ wordvec split (const string& line, const string& delimiters) {
    return words;
 }
 
+// skip_while -
+//    Returns the first position at or after itor whose char is a
+//    delimiter (want_delim) or is not one (not want_delim).
+
+static inline bool is_blank (char chr) {
+   return chr == ' ' or chr == '\t';
+}
+
+static const char* skip_while (const char* itor, const char* end,
+                               bool want_delim) {
+#ifdef __SSE2__
+   const __m128i spaces = _mm_set1_epi8 (' ');
+   const __m128i tabs = _mm_set1_epi8 ('\t');
+   for (; end - itor >= 16; itor += 16) {
+      __m128i chunk = _mm_loadu_si128 (
+                      reinterpret_cast<const __m128i*> (itor));
+      unsigned delims = _mm_movemask_epi8 (_mm_or_si128 (
+                        _mm_cmpeq_epi8 (chunk, spaces),
+                        _mm_cmpeq_epi8 (chunk, tabs)));
+      unsigned hits = want_delim ? delims : ~delims & 0xFFFF;
+      if (hits != 0) return itor + __builtin_ctz (hits);
+   }
+#endif
+   while (itor != end and is_blank (*itor) != want_delim) ++itor;
+   return itor;
+}
+
+void split_words (string_view line, viewvec& words) {
+   words.clear();
+   const char* end = line.data() + line.size();
+   for (const char* itor = line.data();;) {
+      const char* start = skip_while (itor, end, false);
+      if (start == end) break;
+      itor = skip_while (start, end, true);
+      words.emplace_back (start, itor - start);
+   }
+}
+
+size_t find_text (string_view text, string_view pattern,
+                  size_t from) {
+   size_t size = pattern.size();
+   if (from > text.size() or size > text.size() - from) {
+      return string_view::npos;
+   }
+   if (size == 0) return from;
+   if (size == 1) {
+      const void* found = memchr (text.data() + from, pattern.front(),
+                                  text.size() - from);
+      return found == nullptr ? string_view::npos
+             : static_cast<const char*> (found) - text.data();
+   }
+#ifdef __SSE2__
+   const char* data = text.data();
+   size_t starts = text.size() - size + 1;  // places it may begin
+   const __m128i firsts = _mm_set1_epi8 (pattern.front());
+   const __m128i lasts = _mm_set1_epi8 (pattern.back());
+   size_t middle = size - 2;
+   for (; starts - from >= 16; from += 16) {
+      __m128i heads = _mm_loadu_si128 (
+                      reinterpret_cast<const __m128i*> (data + from));
+      __m128i tails = _mm_loadu_si128 (
+                      reinterpret_cast<const __m128i*> (
+                      data + from + size - 1));
+      unsigned hits = _mm_movemask_epi8 (_mm_and_si128 (
+                      _mm_cmpeq_epi8 (heads, firsts),
+                      _mm_cmpeq_epi8 (tails, lasts)));
+      while (hits != 0) {
+         size_t at = from + __builtin_ctz (hits);
+         if (memcmp (data + at + 1, pattern.data() + 1, middle) == 0) {
+            return at;
+         }
+         hits &= hits - 1;
+      }
+   }
+#endif
+   return text.find (pattern, from);
+}
+
+ostream& operator<< (ostream& out, const wordspan& words) {
+   string space = "";
+   for (const auto& word: words) {
+      out << space << word;
+      space = " ";
+   }
+   return out;
+}
+
+output_sink::output_sink (int fd, size_t capacity):
+             fd_ (fd), capacity_ (capacity),
+             buffer_ (make_unique<char[]> (capacity)) {
+}
+
+output_sink::~output_sink() {
+   flush();
+}
+
+void output_sink::write_all (const char* data, size_t size) {
+   while (size > 0) {
+      ssize_t wrote = ::write (fd_, data, size);
+      if (wrote < 0) {
+         if (errno == EINTR) continue;
+         return;
+      }
+      ++writes_;
+      stats::count (counter::BYTES_WRITTEN, wrote);
+      data += wrote;
+      size -= wrote;
+   }
+}
+
+void output_sink::flush() {
+   if (fd_ < 0) return;
+   write_all (buffer_.get(), used_);
+   used_ = 0;
+}
+
+void output_sink::make_room (size_t size) {
+   if (fd_ >= 0) {
+      flush();
+      return;
+   }
+   size_t grown = max (capacity_ * 2, used_ + size);
+   unique_ptr<char[]> bigger (new char[grown]);
+   memcpy (bigger.get(), buffer_.get(), used_);
+   buffer_ = move (bigger);
+   capacity_ = grown;
+}
+
+output_sink& output_sink::operator<< (string_view text) {
+   if (capacity_ - used_ < text.size()) {
+      make_room (text.size());
+      // Too big to be worth buffering, so write it as it is.
+      if (text.size() > capacity_ - used_) {
+         write_all (text.data(), text.size());
+         return *this;
+      }
+   }
+   memcpy (buffer_.get() + used_, text.data(), text.size());
+   used_ += text.size();
+   return *this;
+}
+
+output_sink& output_sink::operator<< (char chr) {
+   if (used_ == capacity_) make_room (1);
+   buffer_[used_++] = chr;
+   return *this;
+}
+
+void output_sink::append_number (long long number, int width) {
+   char digits[24];
+   char* end = to_chars (digits, digits + sizeof digits, number).ptr;
+   int length = end - digits;
+   size_t needed = max (length, width);
+   if (capacity_ - used_ < needed) make_room (needed);
+   for (; width > length; --width) buffer_[used_++] = ' ';
+   memcpy (buffer_.get() + used_, digits, length);
+   used_ += length;
+}
+
+// Where output and complain write on this thread, when redirected.
+static thread_local output_sink* scoped_output {nullptr};
+static thread_local ostream* scoped_errors {nullptr};
+
+output_sink& output() {
+   static output_sink sink (STDOUT_FILENO);
+   return scoped_output != nullptr ? *scoped_output : sink;
+}
+
+output_scope::output_scope (output_sink& out, ostream& errors):
+              saved_output (scoped_output),
+              saved_errors (scoped_errors) {
+   scoped_output = &out;
+   scoped_errors = &errors;
+}
+
+output_scope::~output_scope() {
+   scoped_output = saved_output;
+   scoped_errors = saved_errors;
+}
+
 ostream& complain() {
-   exec::status (EXIT_FAILURE);
-   cerr << exec::execname() << ": ";
-   return cerr;
+   output().flush();
+   if (scoped_errors == nullptr) exec::status (EXIT_FAILURE);
+   ostream& errors = scoped_errors != nullptr ? *scoped_errors : cerr;
+   errors << exec::execname() << ": ";
+   return errors;
 }
 
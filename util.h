@@ -7,9 +7,13 @@
 #ifndef __UTIL_H__
 #define __UTIL_H__
 
+#include <atomic>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 using namespace std;
 
@@ -19,8 +23,36 @@ template <typename iterator>
 using range_type = pair<iterator,iterator>;
 
 using wordvec = vector<string>;
+using viewvec = vector<string_view>;
 using word_range = range_type<decltype(declval<wordvec>().cbegin())>;
 
+// wordspan -
+//    A view of an array of words, as passed to command functions.
+//    Neither the array nor the words are copied.
+
+class wordspan {
+   private:
+      const string_view* words_ {nullptr};
+      size_t size_ {0};
+   public:
+      wordspan() = default;
+      wordspan (const string_view* words, size_t size):
+                words_ (words), size_ (size) {}
+      wordspan (const viewvec& words):
+                words_ (words.data()), size_ (words.size()) {}
+      size_t size() const { return size_; }
+      bool empty() const { return size_ == 0; }
+      const string_view& operator[] (size_t index) const {
+         return words_[index];
+      }
+      const string_view* begin() const { return words_; }
+      const string_view* end() const { return words_ + size_; }
+      wordspan subspan (size_t from) const {
+         return from < size_ ? wordspan (words_ + from, size_ - from)
+                             : wordspan();
+      }
+};
+
 // want_echo -
 //    We want to echo all of cin to cout if either cin or cout
 //    is not a tty.  This helps make batch processing easier by
@@ -39,7 +71,7 @@ bool want_echo();
 class exec {
    private:
       static string execname_;
-      static int status_;
+      static atomic<int> status_;
       static void execname (const string& argv0);
       friend int main (int, char**);
    public:
@@ -56,10 +88,104 @@ class exec {
 
 wordvec split (const string& line, const string& delimiter);
 
+// split_words -
+//    Split a shell command into views of the line, separated by
+//    spaces and tabs.  Nothing is copied, and the vector is cleared
+//    and reused so that no allocation happens once it has grown.
+//    Delimiters are found sixteen bytes at a time where SSE2 is
+//    available.
+
+void split_words (string_view line, viewvec& words);
+
+// find_text -
+//    Returns where a pattern first occurs in a text at or after a
+//    position, or npos.  Where SSE2 is available, sixteen places are
+//    tried at once by comparing their first and last bytes with
+//    those of the pattern, and only where both agree is the rest
+//    compared, so text is scanned at close to the speed of memory.
+
+size_t find_text (string_view text, string_view pattern,
+                  size_t from = 0);
+
+// output_sink -
+//    Buffered writer for a file descriptor.  Text is collected in
+//    one large buffer and written with a single write(2) when the
+//    buffer fills or flush is called, instead of once per line as
+//    with endl.  Numbers are formatted with to_chars.  A sink made
+//    without a file descriptor keeps everything in memory, growing
+//    as needed, so that work done on another thread can be rendered
+//    and written out later with text(), then emptied with clear().
+// column -
+//    A number to be right justified in a field, like setw.
+// output -
+//    The sink on standard output, where commands write.  Main
+//    flushes it before waiting for input, and complain flushes it so
+//    that errors appear after the output that preceded them.
+// output_scope -
+//    While one lives, output and complain on the calling thread write
+//    to the given sink and stream instead, and complaints leave the
+//    exit status alone.  The server runs each session's commands
+//    inside one, so that a client sees its own errors.
+
+struct column {
+   long long value;
+   int width;
+   column (long long number, int field):
+          value (number), width (field) {}
+};
+
+class output_sink {
+   private:
+      int fd_;
+      size_t capacity_;
+      unique_ptr<char[]> buffer_;
+      size_t used_ {0};
+      size_t writes_ {0};
+      void write_all (const char* data, size_t size);
+      void append_number (long long number, int width);
+      void make_room (size_t size);
+   public:
+      explicit output_sink (int fd, size_t capacity = 1 << 16);
+      output_sink(): output_sink (-1, 1 << 12) {}
+      output_sink (const output_sink&) = delete;
+      output_sink& operator= (const output_sink&) = delete;
+      ~output_sink();
+      output_sink& operator<< (string_view text);
+      output_sink& operator<< (char chr);
+      output_sink& operator<< (column number) {
+         append_number (number.value, number.width);
+         return *this;
+      }
+      template <typename number_t,
+                typename = enable_if_t<is_integral_v<number_t>>>
+      output_sink& operator<< (number_t number) {
+         append_number (number, 0);
+         return *this;
+      }
+      void flush();
+      void clear() { used_ = 0; }
+      size_t writes() const { return writes_; }
+      string_view text() const { return {buffer_.get(), used_}; }
+};
+
+output_sink& output();
+
+class output_scope {
+   private:
+      output_sink* saved_output;
+      ostream* saved_errors;
+   public:
+      output_scope (output_sink& out, ostream& errors);
+      output_scope (const output_scope&) = delete;
+      output_scope& operator= (const output_scope&) = delete;
+      ~output_scope();
+};
+
 // complain -
 //    Used for starting error messages.  Sets the exit status to
 //    EXIT_FAILURE, writes the program name to cerr, and then
-//    returns the cerr ostream.  Example:
+//    returns the cerr ostream, or the stream of the output_scope in
+//    effect.  Example:
 //       complain() << filename << ": some problem" << endl;
 
 ostream& complain();
@@ -80,6 +206,8 @@ ostream& operator<< (ostream& out, const vector<item_t>& vec) {
    return out;
 }
 
+ostream& operator<< (ostream& out, const wordspan& words);
+
 template <typename iterator>
 ostream& operator<< (ostream& out, range_type<iterator> range) {
    for (auto itor = range.first; itor != range.second; ++itor) {
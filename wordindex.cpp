@@ -0,0 +1,200 @@
+// $Id: wordindex.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <algorithm>
+
+using namespace std;
+
+#include "debug.h"
+#include "wordindex.h"
+
+static void put_varint (string& out, size_t value) {
+   for (; value >= 0x80; value >>= 7) {
+      out += static_cast<char> (value | 0x80);
+   }
+   out += static_cast<char> (value);
+}
+
+// get_varint -
+//    Reads one varint written by put_varint.  The lists are only
+//    ever written here, so there is no need to check for the end.
+
+static size_t get_varint (const char*& in) {
+   size_t value = 0;
+   for (int shift = 0;; shift += 7) {
+      unsigned char byte = *in++;
+      value |= static_cast<size_t> (byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) return value;
+   }
+}
+
+// each -
+//    Calls visit on each number in the list, in order:  the packed
+//    ones merged with those added, less those removed.
+
+template <typename visit_t>
+void word_index::postings::each (visit_t visit) const {
+   const char* in = packed.data();
+   size_t next_added = 0;
+   size_t next_removed = 0;
+   int number = 0;
+   for (size_t index = 0; index < packed_count; ++index) {
+      number += get_varint (in);
+      while (next_added < added.size()
+             and added[next_added] < number) {
+         visit (added[next_added++]);
+      }
+      while (next_removed < removed.size()
+             and removed[next_removed] < number) {
+         ++next_removed;
+      }
+      if (next_removed < removed.size()
+          and removed[next_removed] == number) continue;
+      visit (number);
+   }
+   for (; next_added < added.size(); ++next_added) {
+      visit (added[next_added]);
+   }
+}
+
+// insert -
+//    A number after every packed one is appended to the list at
+//    once.  Any other goes aside until the next fold.
+
+void word_index::postings::insert (int number) {
+   auto gone = lower_bound (removed.begin(), removed.end(), number);
+   if (gone != removed.end() and *gone == number) {
+      removed.erase (gone);
+      return;
+   }
+   auto at = lower_bound (added.begin(), added.end(), number);
+   if (at != added.end() and *at == number) return;
+   if (number > last) {
+      put_varint (packed, number - last);
+      ++packed_count;
+      last = number;
+      return;
+   }
+   added.insert (at, number);
+   fold_if_due();
+}
+
+void word_index::postings::erase (int number) {
+   auto at = lower_bound (added.begin(), added.end(), number);
+   if (at != added.end() and *at == number) {
+      added.erase (at);
+      return;
+   }
+   auto gone = lower_bound (removed.begin(), removed.end(), number);
+   if (gone != removed.end() and *gone == number) return;
+   removed.insert (gone, number);
+   fold_if_due();
+}
+
+void word_index::postings::fold_if_due() {
+   size_t limit = 8;
+   while (limit * limit < packed_count) limit *= 2;
+   if (added.size() + removed.size() <= limit) return;
+   string merged;
+   size_t count = 0;
+   int previous = 0;
+   each ([&merged, &count, &previous] (int number) {
+      put_varint (merged, number - previous);
+      previous = number;
+      ++count;
+   });
+   merged.shrink_to_fit();
+   packed = move (merged);
+   packed_count = count;
+   last = previous;
+   vector<int>().swap (added);
+   vector<int>().swap (removed);
+}
+
+size_t word_index::postings::bytes() const {
+   return packed.capacity()
+        + (added.capacity() + removed.capacity()) * sizeof (int);
+}
+
+// distinct -
+//    The words of a text, each once.  The views are into the text.
+
+vector<string_view> word_index::distinct (const file_content& text) {
+   vector<string_view> result;
+   result.reserve (text.word_count());
+   for (size_t index = 0; index < text.word_count(); ++index) {
+      result.push_back (text.word (index));
+   }
+   sort (result.begin(), result.end());
+   result.erase (unique (result.begin(), result.end()), result.end());
+   return result;
+}
+
+void word_index::enable (bool on) {
+   lock_guard<mutex> guard (lock);
+   enabled_.store (on, memory_order_relaxed);
+   if (not on) {
+      unordered_map<string,postings>().swap (words);
+      unordered_map<int,const inode*>().swap (files);
+   }
+}
+
+void word_index::add_locked (int number, const inode* node,
+                             const file_content& text) {
+   files[number] = node;
+   for (string_view word: distinct (text)) {
+      words[string (word)].insert (number);
+   }
+}
+
+void word_index::add (int number, const inode* node,
+                      const file_content& text) {
+   if (not enabled()) return;
+   lock_guard<mutex> guard (lock);
+   add_locked (number, node, text);
+}
+
+void word_index::remove (int number, const file_content& text) {
+   if (not enabled()) return;
+   lock_guard<mutex> guard (lock);
+   if (files.erase (number) == 0) return;
+   for (string_view word: distinct (text)) {
+      auto found = words.find (string (word));
+      if (found == words.end()) continue;
+      found->second.erase (number);
+      if (found->second.size() == 0) words.erase (found);
+   }
+}
+
+void word_index::rebuild (vector<indexed_file> all) {
+   sort (all.begin(), all.end(),
+         [] (const indexed_file& left, const indexed_file& right) {
+            return left.number < right.number;
+         });
+   lock_guard<mutex> guard (lock);
+   unordered_map<string,postings>().swap (words);
+   unordered_map<int,const inode*>().swap (files);
+   for (const auto& each: all) {
+      add_locked (each.number, each.node, *each.text);
+   }
+   DEBUGF ('x', all.size() << " files, " << words.size() << " words");
+}
+
+vector<const inode*> word_index::find (string_view word) const {
+   lock_guard<mutex> guard (lock);
+   vector<const inode*> result;
+   auto found = words.find (string (word));
+   if (found == words.end()) return result;
+   result.reserve (found->second.size());
+   found->second.each ([this, &result] (int number) {
+      result.push_back (files.at (number));
+   });
+   return result;
+}
+
+word_index_usage word_index::usage() const {
+   lock_guard<mutex> guard (lock);
+   word_index_usage result {files.size(), words.size(), 0};
+   for (const auto& each: words) result.bytes += each.second.bytes();
+   return result;
+}
+
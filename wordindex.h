@@ -0,0 +1,100 @@
+// $Id: wordindex.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// word_index -
+//    Which plain files hold each word, for search.  Each tree has one,
+//    off until it is turned on, since keeping it costs time on every
+//    make and rm and memory for every distinct word.  While it is on,
+//    it holds exactly the files linked into the tree:  a file is
+//    added when it is made and taken out when it is unlinked, before
+//    its link is let go, so a file found in the index is good until
+//    the caller's read-side section ends.  Changes that replace much
+//    of the tree at once, load and rollback, build it again.
+//    A word's postings are the inode numbers of the files that hold
+//    it, in order, stored as the differences between neighbours in a
+//    varint each, so a file made after the rest costs a byte or two
+//    at the end of each of its words.  Numbers added out of order,
+//    and numbers removed, are kept aside in small sorted vectors and
+//    folded into the list once they outgrow about its square root,
+//    as a directory folds its changes.
+// add, remove -
+//    Adds a file under each distinct word of its text, or takes it
+//    out of them.  Both do nothing while the index is off.
+// rebuild -
+//    Forgets everything and adds every file given, in order by inode
+//    number, so that every list is built by appending.
+// find -
+//    The files that hold a word, in order by inode number.  Takes
+//    time in the number of them, not in the size of the tree.
+// usage -
+//    The number of files and distinct words indexed, and the bytes
+//    their postings take.
+
+#ifndef __WORDINDEX_H__
+#define __WORDINDEX_H__
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+#include "content.h"
+
+class inode;
+
+struct indexed_file {
+   int number;
+   const inode* node;
+   const file_content* text;
+};
+
+struct word_index_usage {
+   size_t files {0};
+   size_t words {0};
+   size_t bytes {0};
+};
+
+class word_index {
+   private:
+      class postings {
+         private:
+            string packed;       // deltas from the one before
+            size_t packed_count {0};
+            int last {0};        // the largest number packed
+            vector<int> added;   // sorted, not in packed
+            vector<int> removed; // sorted, in packed
+            void fold_if_due();
+         public:
+            void insert (int number);
+            void erase (int number);
+            size_t size() const {
+               return packed_count + added.size() - removed.size();
+            }
+            size_t bytes() const;
+            template <typename visit_t>
+            void each (visit_t visit) const;
+      };
+      mutable mutex lock;
+      atomic<bool> enabled_ {false};
+      unordered_map<string,postings> words;
+      unordered_map<int,const inode*> files;
+      static vector<string_view> distinct (const file_content& text);
+      void add_locked (int number, const inode* node,
+                       const file_content& text);
+   public:
+      bool enabled() const {
+         return enabled_.load (memory_order_relaxed);
+      }
+      void enable (bool on);
+      void add (int number, const inode* node,
+                const file_content& text);
+      void remove (int number, const file_content& text);
+      void rebuild (vector<indexed_file> all);
+      vector<const inode*> find (string_view word) const;
+      word_index_usage usage() const;
+};
+
+#endif
+
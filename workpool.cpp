@@ -0,0 +1,119 @@
+// $Id: workpool.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <iostream>
+
+using namespace std;
+
+#include "debug.h"
+#include "workpool.h"
+
+// The pool and queue index of the worker running on this thread, if
+// any, so that submit can find the worker's own queue.
+static thread_local const work_pool* current_pool {nullptr};
+static thread_local size_t current_queue {0};
+
+work_pool::work_pool (size_t threads) {
+   for (size_t index = 0; index <= threads; ++index) {
+      queues.push_back (make_unique<task_queue>());
+   }
+   for (size_t index = 0; index < threads; ++index) {
+      workers.emplace_back (&work_pool::work, this, index);
+   }
+   DEBUGF ('w', threads << " workers started");
+}
+
+work_pool::~work_pool() {
+   {
+      lock_guard<mutex> lock (idle_lock);
+      stopping = true;
+   }
+   idle.notify_all();
+   for (auto& worker: workers) worker.join();
+}
+
+size_t work_pool::own_queue() const {
+   return current_pool == this ? current_queue : outside_queue();
+}
+
+void work_pool::submit (task job, work_group* group) {
+   // Count the task before it can be seen, so that wait cannot find
+   // nothing pending while it is still on its way to a queue.
+   pending.fetch_add (1);
+   if (group != nullptr) group->pending.fetch_add (1);
+   task_queue& queue = *queues[own_queue()];
+   {
+      lock_guard<mutex> lock (queue.lock);
+      queue.tasks.push_back ({move (job), group});
+   }
+   queued.fetch_add (1);
+   {
+      lock_guard<mutex> lock (idle_lock);
+   }
+   idle.notify_one();
+}
+
+bool work_pool::run_one (size_t self) {
+   queued_task job {nullptr, nullptr};
+   size_t count = queues.size();
+   for (size_t offset = 0; offset < count and not job.job; ++offset) {
+      task_queue& queue = *queues[(self + offset) % count];
+      lock_guard<mutex> lock (queue.lock);
+      if (queue.tasks.empty()) continue;
+      if (offset == 0) {
+         job = move (queue.tasks.back());
+         queue.tasks.pop_back();
+      }else {
+         job = move (queue.tasks.front());
+         queue.tasks.pop_front();
+      }
+   }
+   if (not job.job) return false;
+   queued.fetch_sub (1);
+   job.job();
+   // The group may be gone as soon as its count reaches zero, so it
+   // is not touched after.
+   bool group_done = job.group != nullptr
+                     and job.group->pending.fetch_sub (1) == 1;
+   if (pending.fetch_sub (1) == 1 or group_done) {
+      lock_guard<mutex> lock (idle_lock);
+      idle.notify_all();
+   }
+   return true;
+}
+
+void work_pool::work (size_t self) {
+   current_pool = this;
+   current_queue = self;
+   for (;;) {
+      if (run_one (self)) continue;
+      unique_lock<mutex> lock (idle_lock);
+      idle.wait (lock, [this] { return stopping or queued > 0; });
+      if (stopping and queued == 0) return;
+   }
+}
+
+void work_pool::wait() {
+   size_t self = own_queue();
+   while (pending > 0) {
+      if (run_one (self)) continue;
+      unique_lock<mutex> lock (idle_lock);
+      idle.wait (lock, [this] { return pending == 0 or queued > 0; });
+   }
+}
+
+void work_pool::wait (work_group& group) {
+   size_t self = own_queue();
+   while (group.pending > 0) {
+      if (run_one (self)) continue;
+      unique_lock<mutex> lock (idle_lock);
+      idle.wait (lock, [this, &group] {
+         return group.pending == 0 or queued > 0;
+      });
+   }
+}
+
+work_pool& work_pool::shared() {
+   static work_pool pool (max (thread::hardware_concurrency(), 1u));
+   return pool;
+}
+
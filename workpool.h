@@ -0,0 +1,87 @@
+// $Id: workpool.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+// work_pool -
+//    A fixed set of worker threads that run submitted tasks.  Each
+//    worker has its own queue.  Tasks submitted from a worker go on
+//    the back of its own queue, and it takes them back from there, so
+//    a task's children run while their data is still in cache.  An
+//    idle worker steals from the front of another queue, which holds
+//    the oldest and usually the largest pieces of work.  Tasks must
+//    not throw.
+// work_group -
+//    Counts the tasks one caller has submitted and not yet seen
+//    finish, so that callers sharing the pool, such as the sessions
+//    of a server, each wait for their own tasks and no one else's.
+//    It must outlive its tasks, which waiting on it ensures.
+// submit -
+//    Queues a task, in a group if one is given.  From outside the
+//    pool, tasks go on a queue of their own, which every worker
+//    steals from.
+// wait -
+//    Runs tasks on the calling thread until every task submitted so
+//    far, and every task they submitted in turn, has finished; or,
+//    given a group, until every task in it has.  A task that submits
+//    more must put them in its group for them to be waited for.
+// shared -
+//    The process-wide pool, with one worker per hardware thread.  It
+//    is started the first time it is used.
+
+#ifndef __WORKPOOL_H__
+#define __WORKPOOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+class work_group {
+   friend class work_pool;
+   private:
+      atomic<size_t> pending {0};
+};
+
+class work_pool {
+   public:
+      using task = function<void()>;
+   private:
+      struct queued_task {
+         task job;
+         work_group* group;
+      };
+      struct task_queue {
+         mutex lock;
+         deque<queued_task> tasks;
+      };
+      vector<unique_ptr<task_queue>> queues;
+      vector<thread> workers;
+      atomic<size_t> pending {0};
+      atomic<size_t> queued {0};
+      bool stopping {false};
+      mutex idle_lock;
+      condition_variable idle;
+      size_t outside_queue() const { return workers.size(); }
+      size_t own_queue() const;
+      bool run_one (size_t self);
+      void work (size_t self);
+   public:
+      explicit work_pool (size_t threads);
+      work_pool (const work_pool&) = delete;
+      work_pool& operator= (const work_pool&) = delete;
+      ~work_pool();
+      void submit (task job, work_group* group = nullptr);
+      void submit (task job, work_group& group) {
+         submit (move (job), &group);
+      }
+      void wait();
+      void wait (work_group& group);
+      size_t size() const { return workers.size(); }
+      static work_pool& shared();
+};
+
+#endif
+